@@ -0,0 +1,143 @@
+#ifndef GAME_STATE_TRAITS_HPP_
+#define GAME_STATE_TRAITS_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/* GameStateが任意で持つ機能を、コンパイル時に調べるための型特性。 */
+
+/* 対称な局面の代表を返す canonical() と、局面の比較 == を持つか。 */
+template <class GameState, class = void>
+struct has_canonical_form : std::false_type {};
+
+template <class GameState>
+struct has_canonical_form<GameState, std::void_t<decltype(
+    std::declval<const GameState&>().canonical() == std::declval<const GameState&>().canonical())>> : std::true_type {};
+
+/* 局面自体が対称かを返す isSymmetric() を持つか。 */
+template <class GameState, class = void>
+struct has_symmetry_test : std::false_type {};
+
+template <class GameState>
+struct has_symmetry_test<GameState, std::enable_if_t<std::is_same_v<
+    decltype(std::declval<const GameState&>().isSymmetric()), bool>>> : std::true_type {};
+
+/* 状態をその場で書き換える apply(action) と、その返り値で元に戻す undo(action, info) を持つか。 */
+template <class GameState, typename GameAction, class = void>
+struct has_apply_undo : std::false_type {};
+
+template <class GameState, typename GameAction>
+struct has_apply_undo<GameState, GameAction, std::void_t<decltype(std::declval<GameState&>().undo(
+    std::declval<const GameAction&>(), std::declval<GameState&>().apply(std::declval<const GameAction&>())))>> : std::true_type {};
+
+/* stateにactionを適用する。apply()を持てばその場で書き換え、なければnext()で作った状態を代入する。 */
+template <class GameState, typename GameAction>
+void applyAction(GameState& state, const GameAction& action) {
+  if constexpr (has_apply_undo<GameState, GameAction>::value) {
+    state.apply(action);
+  } else {
+    state = state.next(action);
+  }
+}
+
+/* 行動の型を指定して合法手を書き出す legalActions(std::vector<GameAction>&) を持つか。 */
+template <class GameState, typename GameAction, class = void>
+struct has_typed_legal_actions : std::false_type {};
+
+template <class GameState, typename GameAction>
+struct has_typed_legal_actions<GameState, GameAction, std::void_t<decltype(
+    std::declval<const GameState&>().legalActions(std::declval<std::vector<GameAction>&>()))>> : std::true_type {};
+
+/* GameAction型での合法手の全体。legalActions(std::vector<GameAction>&)を持てばそれを使い、なければlegalActions()の返り値。 */
+/* 1つのGameStateを、座標と添字のような複数の行動の型で探索できるようにする。 */
+template <typename GameAction, class GameState>
+std::vector<GameAction> legalActionsOf(const GameState& state) {
+  if constexpr (has_typed_legal_actions<GameState, GameAction>::value) {
+    std::vector<GameAction> actions{};
+    state.legalActions(actions);
+    return actions;
+  } else {
+    return state.legalActions();
+  }
+}
+
+/* 行動を0以上GameState::kNumberOfActionIndices未満の添字に写す static int actionIndex(const GameAction&) を持つか。 */
+template <class GameState, typename GameAction, class = void>
+struct has_action_index : std::false_type {};
+
+template <class GameState, typename GameAction>
+struct has_action_index<GameState, GameAction, std::void_t<
+    decltype(GameState::kNumberOfActionIndices), decltype(GameState::actionIndex(std::declval<const GameAction&>()))>> : std::true_type {};
+
+/* 行動の添字の数。actionIndex()を持たなければ1。 */
+template <class GameState, typename GameAction>
+constexpr int numberOfActionIndices() {
+  if constexpr (has_action_index<GameState, GameAction>::value) {
+    return GameState::kNumberOfActionIndices;
+  } else {
+    return 1;
+  }
+}
+
+/* 局面を識別する値。盤面や手番を64bitずつ詰める。 */
+using PositionKey = std::array<uint64_t, 6>;
+
+/* 局面を識別する値を返す positionKey() を持つか。 */
+template <class GameState, class = void>
+struct has_position_key : std::false_type {};
+
+template <class GameState>
+struct has_position_key<GameState, std::enable_if_t<std::is_convertible_v<
+    decltype(std::declval<const GameState&>().positionKey()), PositionKey>>> : std::true_type {};
+
+/* stateを識別する値。positionKey()を持たなければ、どの局面も同じ値(すべて0)になる。 */
+template <class GameState>
+PositionKey positionKeyOf(const GameState& state) {
+  if constexpr (has_position_key<GameState>::value) {
+    return state.positionKey();
+  } else {
+    return PositionKey{};
+  }
+}
+
+/* 遷移先が対称な局面になる行動をまとめ、それぞれの代表(最初に現れたもの)だけを残す。 */
+/* GameStateがcanonical()を持たなければ、actionsをそのまま返す。 */
+/* isSymmetric()も持てば、局面自体が対称なときだけまとめる。対称な局面は序盤にしか現れないので、それ以外の展開では */
+/* 行動ごとの遷移と正規化を省く。対称でない局面から対称な2局面に遷移する稀な場合は、まとめずに別の行動として扱う。 */
+template <class GameState, typename GameAction>
+std::vector<GameAction> uniqueActionsUnderSymmetry(const GameState& state, std::vector<GameAction> actions) {
+  if constexpr (has_symmetry_test<GameState>::value) {
+    if (actions.size() <= 1 || !state.isSymmetric()) { return actions; }
+  }
+  if constexpr (has_canonical_form<GameState>::value) {
+    std::vector<GameState> canonical_states{};
+    canonical_states.reserve(actions.size());
+    GameState next_state{state};
+    auto last{std::remove_if(actions.begin(), actions.end(), [&](const GameAction& action) {
+      /* apply()を持てば、1つの状態を書き換えては戻して、行動ごとの複製を避ける。 */
+      const GameState canonical_state{[&]() {
+        if constexpr (has_apply_undo<GameState, GameAction>::value) {
+          const auto info{next_state.apply(action)};
+          const GameState result{next_state.canonical()};
+          next_state.undo(action, info);
+          return result;
+        } else {
+          return state.next(action).canonical();
+        }
+      }()};
+      if (std::find(canonical_states.begin(), canonical_states.end(), canonical_state) != canonical_states.end()) {
+        return true;
+      }
+      canonical_states.push_back(canonical_state);
+      return false;
+    })};
+    actions.erase(last, actions.end());
+  }
+  return actions;
+}
+
+#endif // GAME_STATE_TRAITS_HPP_
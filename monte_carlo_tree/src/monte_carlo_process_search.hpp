@@ -0,0 +1,228 @@
+#ifndef MONTE_CARLO_PROCESS_SEARCH_HPP_
+#define MONTE_CARLO_PROCESS_SEARCH_HPP_
+
+#include <cassert>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "search_control.hpp"
+
+/* fork()した複数のプロセスで同じ局面を独立に探索し(root並列化)、根の子節点の統計を共有メモリに書かせて親がまとめる。 */
+/* プロセスごとにアドレス空間が分かれるので、アロケータの競合がなく、1つのプロセスが落ちても他の結果は残る。 */
+/*
+ * Rootは search(const SearchStopToken&, const SearchProgressCallback<GameAction>&, int) と getChildren() を持つ型
+ * (MonteCarloTreeNode, PrimitiveMonteCarloRoot)で、子節点は getLastAction(), getPlayCount(), getSumScores() を持つ。
+ * 共有メモリにコピーするので、GameActionはポインタを持たず、trivially copy constructibleでなければならない。
+ */
+template <typename GameAction, int kNumberOfPlayers>
+class MonteCarloProcessSearch {
+ public:
+  static_assert(std::is_trivially_copy_constructible<GameAction>::value && std::is_trivially_destructible<GameAction>::value,
+                "GameAction must be trivially copy constructible to be shared between processes.");
+
+  /* 根の子節点1つ分の統計。 */
+  struct ActionStatistics {
+    GameAction action;
+    int play_cnt;
+    std::array<double, kNumberOfPlayers> sum_scores;
+  };
+
+  MonteCarloProcessSearch(const int num_processes, const int max_actions = kMaxActions)
+      : num_processes_(std::max(num_processes, 1)), max_actions_(std::max(max_actions, 1)) {}
+
+  MonteCarloProcessSearch(const MonteCarloProcessSearch&) = delete;
+  MonteCarloProcessSearch& operator=(const MonteCarloProcessSearch&) = delete;
+
+  /* make_root(プロセス番号)で作った根を、各プロセスで探索する。make_rootは子プロセスの中で呼ばれる。 */
+  /* 各プロセスはpublish_interval回ごとに統計を書き出す。stop_tokenで止めると、子プロセスにも停止が伝わる。 */
+  /* 1つでも統計を書き出したプロセスがあればtrueを返す。 */
+  template <class Root>
+  bool search(const std::function<Root(int)>& make_root, const int player_num, const SearchStopToken& stop_token = SearchStopToken(),
+              const int publish_interval = kPublishInterval) {
+    this->statistics_.clear();
+    this->failed_process_cnt_ = 0;
+    this->player_num_ = player_num;
+
+    /* 親子で共有する領域。fork()前に確保すれば、子プロセスからも同じ物理ページが見える。 */
+    const std::size_t size{this->sharedMemorySize()};
+    void* mapped{mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0)};
+    if (mapped == MAP_FAILED) { return false; }
+    const std::unique_ptr<void, std::function<void(void*)>> unmapper(mapped, [size](void* p) { munmap(p, size); });
+    SharedHeader* header{new (mapped) SharedHeader()};
+    for (int i = 0; i < this->num_processes_; i++) {
+      new (this->slot(mapped, i)) SlotHeader();
+    }
+
+    std::vector<pid_t> pids{};
+    for (int i = 0; i < this->num_processes_; i++) {
+      const pid_t pid{fork()};
+      if (pid == 0) {
+        /* 例外を親の呼び出し元まで戻すと、子が親の続きを実行してしまうので、ここで失敗として終える。 */
+        try {
+          this->runWorker<Root>(mapped, i, make_root, stop_token, publish_interval);
+        } catch (...) {
+          _exit(1);
+        }
+        _exit(0); // 親から引き継いだ後始末(静的変数のデストラクタなど)は走らせない。
+      }
+      if (pid > 0) {
+        pids.push_back(pid);
+      } else {
+        this->failed_process_cnt_++;
+      }
+    }
+
+    /* 子プロセスの終了を待つ間も、親のstop_tokenを見て停止を伝える。 */
+    std::size_t running_cnt{pids.size()};
+    std::vector<bool> is_finished(pids.size(), false);
+    while (running_cnt > 0) {
+      if (stop_token.isStopRequested()) {
+        header->is_stopped.store(true);
+      }
+      for (std::size_t i = 0; i < pids.size(); i++) {
+        if (is_finished.at(i)) { continue; }
+        int status{};
+        if (waitpid(pids.at(i), &status, WNOHANG) == pids.at(i)) {
+          is_finished.at(i) = true;
+          running_cnt--;
+          if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            this->failed_process_cnt_++;
+          }
+        }
+      }
+      if (running_cnt > 0) {
+        std::this_thread::sleep_for(kPollInterval);
+      }
+    }
+
+    /* 異常終了したプロセスも、最後に書き終えた統計は使う。 */
+    for (int i = 0; i < this->num_processes_; i++) {
+      this->aggregate(mapped, i);
+    }
+    return !this->statistics_.empty();
+  }
+
+  /* 全プロセスの統計をまとめた上で、最も平均得点の高い行動。 */
+  GameAction getBestAction() const {
+    assert(!this->statistics_.empty());
+    return std::max_element(this->statistics_.begin(), this->statistics_.end(),
+        [this](const ActionStatistics& a, const ActionStatistics& b) {
+          return this->meanScore(a) < this->meanScore(b);
+        })->action;
+  }
+
+  /* 全プロセスの統計をまとめたもの。 */
+  const std::vector<ActionStatistics>& getStatistics() const { return this->statistics_; }
+
+  /* fork()に失敗したか、異常終了したプロセスの数。 */
+  int getFailedProcessCount() const { return this->failed_process_cnt_; }
+
+ private:
+  static constexpr int kMaxActions{64};                                   // 根の子節点数の上限の既定値。
+  static constexpr int kPublishInterval{1000};                            // 統計を書き出す間隔(探索回数)の既定値。
+  static constexpr std::chrono::microseconds kPollInterval{200};          // 子プロセスの終了と停止要求を確かめる間隔。
+
+  struct SharedHeader {
+    std::atomic<bool> is_stopped{false};
+  };
+
+  /* プロセスごとの書き込み先。統計は2面持ち、書き終えた面の番号をsequenceの偶奇で示す。 */
+  /* 書いている途中でプロセスが落ちても、もう一方の面は壊れない。 */
+  struct SlotHeader {
+    std::atomic<uint32_t> sequence{0}; // 書き出した回数。0なら一度も書き出していない。
+    std::array<int, 2> action_cnt{};
+  };
+
+  int num_processes_;
+  int max_actions_;
+  int player_num_{};
+  int failed_process_cnt_{};
+  std::vector<ActionStatistics> statistics_{};
+
+  std::size_t slotSize() const {
+    return sizeof(SlotHeader) + 2 * this->max_actions_ * sizeof(ActionStatistics);
+  }
+
+  std::size_t sharedMemorySize() const {
+    return sizeof(SharedHeader) + this->num_processes_ * this->slotSize();
+  }
+
+  SlotHeader* slot(void* mapped, const int process_index) const {
+    return reinterpret_cast<SlotHeader*>(static_cast<char*>(mapped) + sizeof(SharedHeader) + process_index * this->slotSize());
+  }
+
+  ActionStatistics* page(SlotHeader* slot, const int page_index) const {
+    return reinterpret_cast<ActionStatistics*>(reinterpret_cast<char*>(slot) + sizeof(SlotHeader)) + page_index * this->max_actions_;
+  }
+
+  /* 子プロセス側。探索しながら、根の子節点の統計を書き出す。 */
+  template <class Root>
+  void runWorker(void* mapped, const int process_index, const std::function<Root(int)>& make_root,
+                 const SearchStopToken& stop_token, const int publish_interval) {
+    SharedHeader* header{static_cast<SharedHeader*>(mapped)};
+    SlotHeader* slot{this->slot(mapped, process_index)};
+
+    /* 共有領域の停止フラグを、親のstop_token(期限を含む)と合わせて見る。領域は親が解放するので、ここでは解放しない。 */
+    const std::shared_ptr<const std::atomic<bool>> is_stopped(&header->is_stopped, [](const std::atomic<bool>*) {});
+    const SearchStopToken worker_token{SearchStopToken(is_stopped, SearchStopToken::Clock::time_point::max()).withDeadline(stop_token.getDeadline())};
+
+    Root root{make_root(process_index)};
+    const auto publish{[&]() {
+      const uint32_t sequence{slot->sequence.load(std::memory_order_relaxed)};
+      const int page_index{(int)((sequence + 1) % 2)};
+      ActionStatistics* statistics{this->page(slot, page_index)};
+      int action_cnt{};
+      for (const auto& child : root.getChildren()) {
+        if (action_cnt >= this->max_actions_) { break; }
+        new (&statistics[action_cnt++]) ActionStatistics{child.getLastAction(), child.getPlayCount(), child.getSumScores()};
+      }
+      slot->action_cnt.at(page_index) = action_cnt;
+      slot->sequence.store(sequence + 1, std::memory_order_release);
+    }};
+    root.search(worker_token, [&publish](const SearchProgress<GameAction>&) { publish(); }, publish_interval);
+    publish();
+  }
+
+  /* 親プロセス側。process_index番目のプロセスが最後に書き終えた統計を足し込む。 */
+  void aggregate(void* mapped, const int process_index) {
+    SlotHeader* slot{this->slot(mapped, process_index)};
+    const uint32_t sequence{slot->sequence.load(std::memory_order_acquire)};
+    if (sequence == 0) { return; }
+
+    const int page_index{(int)(sequence % 2)};
+    const ActionStatistics* statistics{this->page(slot, page_index)};
+    for (int i = 0; i < slot->action_cnt.at(page_index); i++) {
+      const ActionStatistics& src{statistics[i]};
+      auto dst{std::find_if(this->statistics_.begin(), this->statistics_.end(),
+          [&src](const ActionStatistics& s) { return s.action == src.action; })};
+      if (dst == this->statistics_.end()) {
+        this->statistics_.push_back(src);
+        continue;
+      }
+      dst->play_cnt += src.play_cnt;
+      for (int j = 0; j < kNumberOfPlayers; j++) {
+        dst->sum_scores.at(j) += src.sum_scores.at(j);
+      }
+    }
+  }
+
+  double meanScore(const ActionStatistics& statistics) const {
+    return (statistics.play_cnt > 0) ? statistics.sum_scores.at(this->player_num_) / statistics.play_cnt : 0.0;
+  }
+};
+
+#endif // MONTE_CARLO_PROCESS_SEARCH_HPP_
@@ -0,0 +1,270 @@
+#ifndef MONTE_CARLO_SEARCH_SCHEDULER_HPP_
+#define MONTE_CARLO_SEARCH_SCHEDULER_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "worker_placement.hpp"
+
+/* 探索要求の処理状況の集計。 */
+struct SearchSchedulerStatistics {
+  int submitted_cnt;         // 受け付けた要求の数。
+  int completed_cnt;         // 答えを返した要求の数。
+  int late_cnt;              // 締め切りより後に答えを返した要求の数。
+  long long play_cnt;        // 全要求のプレイアウト回数の合計。
+  long long steal_cnt;       // 他のスレッドから要求を盗んだ回数。
+  double elapsed_seconds;    // スケジューラを作ってからの経過時間。
+  double playouts_per_second;
+  double mean_latency_seconds; // 要求を受け付けてから答えを返すまでの時間の平均。
+  double max_latency_seconds;
+  double max_lateness_seconds; // 締め切りを過ぎてから答えを返すまでの時間の最大。
+};
+
+/* 多数の独立した探索要求を、1つのスレッドプールで細切れにして進める。 */
+/* 要求はおよそ kSliceDuration ずつの探索に分けて実行し、1つの要求を同時に2つのスレッドが進めることはない。 */
+/* 1回分の探索回数は、直前の1回分の速さから要求ごとに決めるので、プレイアウトの重い局面も軽い局面も同じ時間ずつ進む。 */
+/* スレッドごとに待ち行列を持ち、自分の待ち行列が空になったら他のスレッドから最も順位の高い要求を盗む。 */
+/* 待ち行列を一巡するより前に締め切りが来そうな要求は急ぎとし、締め切りの近い順に他のすべての要求より先に進める。 */
+/* 急ぎでない要求は待ち行列に入れた順に進めるので、締め切りの遠い要求も同じ時間ずつ進む。 */
+/* 直前の1回分と同じだけかかるとして、次の1回分を終える前に締め切りが来るなら、その時点で答えを返す。 */
+/* スレッドはsettingsに従ってCPUに固定し、探索で作る子の配列をそのスレッドのNodeArenaから確保できる。 */
+template <typename GameAction>
+class MonteCarloSearchScheduler {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit MonteCarloSearchScheduler(const int num_threads = std::thread::hardware_concurrency(),
+                                     const WorkerPoolSettings& settings = WorkerPoolSettings())
+      : queues_(std::max(num_threads, 1)) {
+    for (int i = 0; i < (int)this->queues_.size(); i++) {
+      this->workers_.emplace_back([this, i, settings]() {
+        const WorkerThreadScope worker_scope(settings, i);
+        this->work(i);
+      });
+    }
+  }
+
+  MonteCarloSearchScheduler(const MonteCarloSearchScheduler&) = delete;
+  MonteCarloSearchScheduler& operator=(const MonteCarloSearchScheduler&) = delete;
+
+  /* スレッドを止める。実行中の1回分を終えたら、待っている要求にはその時点の最善手を返す。 */
+  ~MonteCarloSearchScheduler() {
+    {
+      std::lock_guard<std::mutex> lock(this->idle_mutex_);
+      this->is_stopping_ = true;
+    }
+    this->idle_condition_.notify_all();
+    for (std::thread& worker : this->workers_) {
+      worker.join();
+    }
+    for (Queue& queue : this->queues_) {
+      for (std::unique_ptr<Request>& request : queue.requests) {
+        request->promise.set_value(request->best_action());
+      }
+    }
+  }
+
+  /* rootの探索を、締め切りdeadlineかプレイアウトplayout_limit回のどちらかに達するまで進め、最善手をfutureで返す。 */
+  /* RootはsearchSteps(int)とgetBestAction()を持つ型(MonteCarloTreeNode, PrimitiveMonteCarloRoot)。 */
+  /* 答えが返るまでrootを破棄したり触ったりしてはいけない。 */
+  template <class Root>
+  std::future<GameAction> submit(Root& root, const Clock::time_point deadline,
+                                 const int playout_limit = std::numeric_limits<int>::max()) {
+    auto request{std::make_unique<Request>()};
+    request->search_steps = [&root](const int iteration_cnt) { return root.searchSteps(iteration_cnt); };
+    request->best_action = [&root]() { return root.getBestAction(); };
+    request->submit_time = Clock::now();
+    request->deadline = deadline;
+    request->playout_limit = playout_limit;
+    std::future<GameAction> result{request->promise.get_future()};
+
+    this->submitted_cnt_++;
+    this->push(this->next_queue_++ % this->queues_.size(), std::move(request));
+    return result;
+  }
+
+  SearchSchedulerStatistics getStatistics() const {
+    std::lock_guard<std::mutex> lock(this->statistics_mutex_);
+    SearchSchedulerStatistics result{this->statistics_};
+    result.submitted_cnt = this->submitted_cnt_;
+    result.play_cnt = 0;
+    result.steal_cnt = 0;
+    for (const Queue& queue : this->queues_) {
+      result.play_cnt += queue.play_cnt;
+      result.steal_cnt += queue.steal_cnt;
+    }
+    result.elapsed_seconds = std::chrono::duration<double>(Clock::now() - this->start_time_).count();
+    result.playouts_per_second = (result.elapsed_seconds > 0.0) ? result.play_cnt / result.elapsed_seconds : 0.0;
+    result.mean_latency_seconds = (result.completed_cnt > 0) ? this->sum_latency_seconds_ / result.completed_cnt : 0.0;
+    return result;
+  }
+
+  int getThreadCount() const { return this->queues_.size(); }
+
+ private:
+  static constexpr std::chrono::microseconds kSliceDuration{1000}; // 1回に続けて探索する時間の目安。
+  static constexpr int kInitialSliceIterations{8};   // 速さが分からない最初の1回分の探索回数。
+  static constexpr int kMaxSliceIterations{4096};
+  static constexpr int kUrgentRounds{2}; // 締め切りまでに待ち行列をこの回数だけ一巡できなければ急ぎとする。
+
+  struct Request {
+    std::function<int(int)> search_steps;
+    std::function<GameAction()> best_action;
+    Clock::time_point submit_time;
+    Clock::time_point deadline;
+    bool is_urgent;             // 急ぎなら、急ぎでない要求より先に取り出す。
+    Clock::time_point priority; // 急ぎなら締め切り、そうでなければ待ち行列に入れた時刻。早いほど先に取り出す。
+    unsigned long long sequence; // 順位が同じなら、先に待ち行列に入れた方を先に取り出す。
+    int playout_limit;
+    int play_cnt{};
+    int slice_iteration_cnt{kInitialSliceIterations}; // 次の1回分の探索回数。
+    Clock::duration slice_duration{};                 // 直近の1回分にかかった時間。
+    std::promise<GameAction> promise;
+  };
+
+  /* 順位の最も高い要求が先頭に来るヒープと、そのスレッドの集計。 */
+  /* スレッドごとに書き換えるので、隣の待ち行列とキャッシュラインを共有しないようにする。 */
+  struct alignas(kCacheLineSize) Queue {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Request>> requests;
+    std::atomic<long long> play_cnt{0};  // このスレッドが進めたプレイアウト回数。
+    std::atomic<long long> steal_cnt{0}; // このスレッドが他のスレッドから要求を盗んだ回数。
+  };
+
+  static bool isLowerPriority(const std::unique_ptr<Request>& a, const std::unique_ptr<Request>& b) {
+    if (a->is_urgent != b->is_urgent) { return b->is_urgent; }
+    return (a->priority != b->priority) ? a->priority > b->priority : a->sequence > b->sequence;
+  }
+
+  std::vector<Queue> queues_;
+  std::vector<std::thread> workers_{};
+  std::atomic<std::size_t> next_queue_{0};
+  std::atomic<unsigned long long> next_sequence_{0};
+
+  std::mutex idle_mutex_{};
+  std::condition_variable idle_condition_{};
+  std::atomic<int> queued_cnt_{0}; // 待ち行列にある要求の数。変えるときはidle_mutex_を取る。
+  std::atomic<bool> is_stopping_{false}; // 変えるときはidle_mutex_を取る。
+
+  const Clock::time_point start_time_{Clock::now()};
+  std::atomic<int> submitted_cnt_{0};
+  mutable std::mutex statistics_mutex_{};
+  SearchSchedulerStatistics statistics_{};
+  double sum_latency_seconds_{};
+
+  void push(const std::size_t queue_index, std::unique_ptr<Request> request) {
+    /* 待ち行列の要求がスレッドごとに1回分ずつ進むと、この要求に順番が戻るまでに一巡の時間がかかる。 */
+    const Clock::time_point now{Clock::now()};
+    const int round_slice_cnt{this->queued_cnt_ / (int)this->queues_.size() + 1};
+    request->is_urgent = request->deadline <= now + kUrgentRounds * round_slice_cnt * std::max<Clock::duration>(request->slice_duration, kSliceDuration);
+    request->priority = request->is_urgent ? request->deadline : now;
+    request->sequence = this->next_sequence_++;
+    {
+      Queue& queue{this->queues_.at(queue_index)};
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      queue.requests.push_back(std::move(request));
+      std::push_heap(queue.requests.begin(), queue.requests.end(), isLowerPriority);
+    }
+    {
+      std::lock_guard<std::mutex> lock(this->idle_mutex_);
+      this->queued_cnt_++;
+    }
+    this->idle_condition_.notify_one();
+  }
+
+  /* queue_index番目の待ち行列から、最も順位の高い要求を取り出す。空ならnullptr。 */
+  std::unique_ptr<Request> pop(const std::size_t queue_index) {
+    std::unique_ptr<Request> result{};
+    {
+      Queue& queue{this->queues_.at(queue_index)};
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.requests.empty()) { return nullptr; }
+      std::pop_heap(queue.requests.begin(), queue.requests.end(), isLowerPriority);
+      result = std::move(queue.requests.back());
+      queue.requests.pop_back();
+    }
+    std::lock_guard<std::mutex> lock(this->idle_mutex_);
+    this->queued_cnt_--;
+    return result;
+  }
+
+  /* 自分の待ち行列から取り出し、空なら他の待ち行列から盗む。 */
+  std::unique_ptr<Request> take(const std::size_t own_index) {
+    std::unique_ptr<Request> result{this->pop(own_index)};
+    for (std::size_t i = 1; result == nullptr && i < this->queues_.size(); i++) {
+      result = this->pop((own_index + i) % this->queues_.size());
+      if (result != nullptr) {
+        this->queues_.at(own_index).steal_cnt++;
+      }
+    }
+    return result;
+  }
+
+  void work(const std::size_t own_index) {
+    while (!this->is_stopping_) {
+      std::unique_ptr<Request> request{this->take(own_index)};
+      if (request == nullptr) {
+        std::unique_lock<std::mutex> lock(this->idle_mutex_);
+        this->idle_condition_.wait(lock, [this]() { return this->queued_cnt_ > 0 || this->is_stopping_; });
+        if (this->is_stopping_) { return; }
+        continue;
+      }
+
+      /* 回数に達したか、次の1回分を終える前に締め切りが来るなら、探索せずに答えを返す。 */
+      const int iteration_cnt{std::min(request->slice_iteration_cnt, request->playout_limit - request->play_cnt)};
+      const Clock::time_point slice_start_time{Clock::now()};
+      if (iteration_cnt <= 0 || slice_start_time + request->slice_duration >= request->deadline) {
+        this->complete(std::move(request));
+        continue;
+      }
+
+      const int play_cnt{request->search_steps(iteration_cnt)};
+      request->slice_duration = Clock::now() - slice_start_time;
+      if (play_cnt > 0) {
+        const double seconds_per_iteration{std::chrono::duration<double>(request->slice_duration).count() / iteration_cnt};
+        const double iteration_cnt_per_slice{std::chrono::duration<double>(kSliceDuration).count() / std::max(seconds_per_iteration, 1e-9)};
+        request->slice_iteration_cnt = (int)std::clamp(iteration_cnt_per_slice, 1.0, (double)kMaxSliceIterations);
+      }
+      request->play_cnt += play_cnt;
+      this->queues_.at(own_index).play_cnt += play_cnt;
+
+      /* 探索の必要がなくなったら答えを返す。 */
+      if (play_cnt <= 0) {
+        this->complete(std::move(request));
+      } else {
+        this->push(own_index, std::move(request));
+      }
+    }
+  }
+
+  void complete(std::unique_ptr<Request> request) {
+    const GameAction best_action{request->best_action()};
+    const Clock::time_point now{Clock::now()};
+    const double latency_seconds{std::chrono::duration<double>(now - request->submit_time).count()};
+    const double lateness_seconds{(now > request->deadline) ? std::chrono::duration<double>(now - request->deadline).count() : 0.0};
+
+    /* 答えを受け取った側がすぐに集計を見ても数えられているよう、先に集計する。 */
+    {
+      std::lock_guard<std::mutex> lock(this->statistics_mutex_);
+      this->statistics_.completed_cnt++;
+      this->sum_latency_seconds_ += latency_seconds;
+      this->statistics_.max_latency_seconds = std::max(this->statistics_.max_latency_seconds, latency_seconds);
+      if (lateness_seconds > 0.0) {
+        this->statistics_.late_cnt++;
+        this->statistics_.max_lateness_seconds = std::max(this->statistics_.max_lateness_seconds, lateness_seconds);
+      }
+    }
+    request->promise.set_value(best_action);
+  }
+};
+
+#endif // MONTE_CARLO_SEARCH_SCHEDULER_HPP_
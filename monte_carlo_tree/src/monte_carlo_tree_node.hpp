@@ -3,12 +3,22 @@
 
 #include <cassert>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <cstdint>
 #include <functional>
+#include <future>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <random>
 #include <vector>
 
+#include "game_state_traits.hpp"
+#include "node_arena.hpp"
+#include "search_control.hpp"
+#include "search_profiler.hpp"
 #include "xorshift64.hpp"
 
 /* GameState: GameStateクラスを実装した型。 */
@@ -23,23 +33,44 @@ class MonteCarloTreeNode {
       : current_state_(state), player_num_(player_num), last_action_(last_action), random_seed_(random_seed), random_engine_(random_seed_), selectForPlayout_(selectForPlayout), epsilon_(epsilon) {}
 
   /* 根用。クラスの外側から探索を指示されて最善手を返す。 */
+  /* 既に子節点がある(スナップショットから復元した場合など)なら、その統計を引き継いで探索を続ける。 */
   GameAction search() {
-    int whole_play_cnt{};
+    return this->search(SearchStopToken());
+  }
 
-    this->expand();
+  /* 根用。stop_tokenで止められる探索。progress_interval回ごとと終了時に、探索の状況をon_progressへ渡す。 */
+  GameAction search(const SearchStopToken& stop_token, const SearchProgressCallback<GameAction>& on_progress = nullptr,
+                    const int progress_interval = kProgressInterval) {
+    if (this->children_.size() <= 0) {
+      this->expand();
+    }
 
     /* 探索できない。 */
     assert(this->children_.size() > 0);
 
-    /* 手が1つしかないなら、それを出す。 */
-    if (this->children_.size() == 1) {
+    /* 手が1つしかないなら、それを出す。対称な行動をまとめて子が1つになっただけなら、その下を探索して根の統計を作る。 */
+    if (this->children_.size() == 1 && this->hasSingleLegalAction()) {
       return this->children_.at(0).last_action_;
     }
 
-    /* 探索。とりあえず、時間ではなく回数で探索に制限をかける。 */
-    while (whole_play_cnt < MonteCarloTreeNode::kPlayoutLimit) {
-      whole_play_cnt++;
-      this->searchChild(whole_play_cnt);
+    /* 探索。回数の上限に達するか、停止を要求されるか、最善手が決まるまで続ける。 */
+    const SearchScope search_scope{};
+    const auto start_time{std::chrono::steady_clock::now()};
+    const int start_play_cnt{this->play_cnt_};
+    this->saved_play_cnt_ = 0.0;
+    this->saved_seconds_ = 0.0;
+    for (int i = 0; this->play_cnt_ - start_play_cnt < this->playout_limit_ && !stop_token.isStopRequested(); i++) {
+      this->searchOnce();
+      if (on_progress && (i + 1) % progress_interval == 0) {
+        on_progress(this->makeProgress(start_time, start_play_cnt));
+      }
+      if (this->early_stop_rule_ != EarlyStopRule::kNone && (i + 1) % MonteCarloTreeNode::kEarlyStopInterval == 0 &&
+          this->isSettled(stop_token, start_time, start_play_cnt)) {
+        break;
+      }
+    }
+    if (on_progress) {
+      on_progress(this->makeProgress(start_time, start_play_cnt));
     }
 
     /* [デバッグ] 各子節点の状態と評価値を出力する。 */
@@ -47,7 +78,7 @@ class MonteCarloTreeNode {
       for (const MonteCarloTreeNode<GameState, GameAction, kNumberOfPlayers>& child : this->children_) {
         std::cout << "********************" << std::endl;
         std::cout << "プレイヤ番号: " << player_num_ << std::endl;
-        std::cout << "総プレイアウト回数: " << whole_play_cnt << std::endl;
+        std::cout << "総プレイアウト回数: " << play_cnt_ << std::endl;
         std::cout << "節点の通過回数: " << child.play_cnt_ << std::endl;
         std::cout << "得点和: ";
         for (const int s : sum_scores_) {
@@ -65,6 +96,232 @@ class MonteCarloTreeNode {
     return this->selectChildWithBestMeanScore().last_action_;
   }
 
+  /* 根用。1回のsearch()で行うプレイアウト回数を変える。 */
+  void setPlayoutLimit(const int playout_limit) { this->playout_limit_ = playout_limit; }
+
+  /* 根用。葉に着くたびに同じ葉からleaf_playout_cnt回プレイアウトし、まとめて逆伝播する(leaf並列化)。 */
+  /* 木をたどる回数と逆伝播の回数がleaf_playout_cnt分の1になる。プレイアウト回数の上限は変わらない。 */
+  void setLeafPlayoutCount(const int leaf_playout_cnt) { this->leaf_playout_cnt_ = std::max(leaf_playout_cnt, 1); }
+
+  /* 根用。RAVE(All Moves As First)の統計を選択に混ぜる。0なら使わない。 */
+  /* プレイアウト中に打たれた手の統計も、同じ手番で打てた兄弟節点に反映する。 */
+  /* 混ぜる割合は sqrt(k / (3n + k)) (nは節点の探索回数)で、rave_equivalenceがkにあたる。探索回数がkに近づくほど通常の統計を重く見る。 */
+  /* GameStateが行動の添字(actionIndex())を持つ必要がある。既にある部分木にも設定を写す。 */
+  void setRaveEquivalence(const double rave_equivalence) {
+    static_assert(has_action_index<GameState, GameAction>::value, "RAVE requires GameState::actionIndex().");
+    this->rave_equivalence_ = std::max(rave_equivalence, 0.0);
+    for (MonteCarloTreeNode& child : this->children_) {
+      child.setRaveEquivalence(rave_equivalence);
+    }
+  }
+
+  /* 根用。プレイアウトを終局まで打たずにdepth手で打ち切り、その局面をevaluatorで評価した得点を結果とする。depthが0なら終局まで打つ。 */
+  /* evaluatorは、終局時の得点と同じく0〜1に正規化した各プレイヤの得点を返す。既にある部分木にも設定を写す。 */
+  void setTruncatedPlayout(const int depth, const std::function<std::array<double, kNumberOfPlayers>(const GameState&)>& evaluator) {
+    this->playout_depth_ = std::max(depth, 0);
+    this->evaluateForPlayout_ = evaluator;
+    for (MonteCarloTreeNode& child : this->children_) {
+      child.setTruncatedPlayout(depth, evaluator);
+    }
+  }
+
+  /* 根用。最善手が決まった時点で探索を打ち切る条件を設定する。zはEarlyStopRule::kConfidenceでの信頼区間の幅。 */
+  /* 打ち切って省いたプレイアウト回数と時間は、getSavedPlayoutCount(), getSavedSeconds()で分かる。 */
+  void setEarlyStop(const EarlyStopRule rule, const double z = kEarlyStopConfidence) {
+    this->early_stop_rule_ = rule;
+    this->early_stop_z_ = z;
+  }
+
+  /* 根用。直前のsearch()で打ち切りにより省いたプレイアウト回数。期限つきの探索では、残り時間に今の速さで行えた回数で見積もる。 */
+  double getSavedPlayoutCount() const { return this->saved_play_cnt_; }
+
+  /* 根用。直前のsearch()で打ち切りにより省いた時間(秒)の見積もり。 */
+  double getSavedSeconds() const { return this->saved_seconds_; }
+
+  /* 根用。木全体の節点数に上限を設ける。 */
+  /* pruneがtrueなら、上限に達した時点で訪問回数の少ない部分木を刈り取って探索を続ける。falseなら、以降の展開を止める。 */
+  void setNodeLimit(const std::size_t node_limit, const bool prune = false) {
+    this->node_limit_ = std::max<std::size_t>(node_limit, 1);
+    this->is_pruning_enabled_ = prune;
+  }
+
+  /* 根用。木が使うメモリ量(バイト)で上限を設ける。 */
+  void setMemoryLimit(const std::size_t memory_limit, const bool prune = false) {
+    this->setNodeLimit(memory_limit / sizeof(MonteCarloTreeNode), prune);
+  }
+
+  /* この節点を根とする部分木の節点数。 */
+  std::size_t getNodeCount() const { return this->node_cnt_; }
+
+  /* この節点を根とする部分木が使うメモリ量(バイト)。節点自体の大きさのみで、GameStateが別に確保する領域は含まない。 */
+  std::size_t getMemoryUsage() const { return this->node_cnt_ * sizeof(MonteCarloTreeNode); }
+
+  /* 根用。プレイアウトの代わりにevaluatorで葉を評価する探索。 */
+  /* 葉をbatch_size個集めるまで、選んだ経路にvirtual lossをかけて同じ葉ばかり選ばないようにし、集まったらまとめて評価して逆伝播する。 */
+  /* Evaluatorは std::vector<std::array<double, kNumberOfPlayers>> evaluateBatch(const std::vector<GameState>&) を持つ型で、 */
+  /* 各局面について、プレイアウトの結果と同じく0〜1に正規化した各プレイヤの得点を返す。 */
+  template <class Evaluator>
+  GameAction searchBatched(Evaluator& evaluator, const int batch_size = kBatchSize, const SearchStopToken& stop_token = SearchStopToken()) {
+    if (this->children_.size() <= 0) {
+      this->expand();
+    }
+
+    /* 探索できない。 */
+    assert(this->children_.size() > 0);
+
+    /* 手が1つしかないなら、それを出す。 */
+    if (this->children_.size() == 1 && this->hasSingleLegalAction()) {
+      return this->children_.at(0).last_action_;
+    }
+
+    std::vector<std::vector<MonteCarloTreeNode*>> paths{}; // 評価待ちの葉までの経路。
+    std::vector<GameState> leaf_states{};                   // 評価待ちの葉の局面。
+    paths.reserve(batch_size);
+    leaf_states.reserve(batch_size);
+
+    int evaluation_cnt{};
+    while (evaluation_cnt < this->playout_limit_ && !stop_token.isStopRequested()) {
+      /* 節点数が上限に達したら、訪問回数の少ない部分木を刈り取って空きを作る。評価待ちの経路がないときにだけ行う。 */
+      if (this->is_pruning_enabled_ && this->node_cnt_ >= this->node_limit_) {
+        this->prune();
+      }
+
+      for (int i = 0; i < batch_size && evaluation_cnt < this->playout_limit_; i++, evaluation_cnt++) {
+        std::vector<MonteCarloTreeNode*> path{this->selectLeaf()};
+        const GameState& leaf_state{path.back()->current_state_};
+
+        /* 終局していれば評価器を通さずに結果を逆伝播する。 */
+        if (leaf_state.isFinished()) {
+          backpropagate(path, finalScores(leaf_state));
+          continue;
+        }
+        leaf_states.push_back(leaf_state);
+        paths.push_back(std::move(path));
+      }
+
+      if (leaf_states.size() > 0) {
+        const std::vector<std::array<double, kNumberOfPlayers>> results{evaluator.evaluateBatch(leaf_states)};
+        for (std::size_t i = 0; i < paths.size(); i++) {
+          backpropagate(paths.at(i), results.at(i));
+        }
+      }
+      paths.clear();
+      leaf_states.clear();
+    }
+
+    /* 最善手を選んで返す。 */
+    return this->selectChildWithBestMeanScore().last_action_;
+  }
+
+  /* 根用。executorのスレッドで探索し、最善手をfutureで返す。探索が終わるまでこの節点を破棄したり触ったりしてはいけない。 */
+  /* Executorは post(std::function<void()>) を持つ型(SearchExecutorなど)。要求ごとにスレッドを作らない。 */
+  template <class Executor>
+  std::future<GameAction> searchAsync(Executor& executor, const SearchStopToken& stop_token,
+                                      const SearchProgressCallback<GameAction>& on_progress = nullptr,
+                                      const int progress_interval = kProgressInterval) {
+    auto promise{std::make_shared<std::promise<GameAction>>()};
+    std::future<GameAction> result{promise->get_future()};
+    executor.post([this, promise, stop_token, on_progress, progress_interval]() {
+      try {
+        promise->set_value(this->search(stop_token, on_progress, progress_interval));
+      } catch (...) {
+        promise->set_exception(std::current_exception());
+      }
+    });
+    return result;
+  }
+
+  /* 根用。探索をiteration_cnt回だけ進め、行ったプレイアウト回数を返す。終局しているか手が1つしかなく、探索の必要がなければ0を返す。 */
+  /* MonteCarloSearchSchedulerのように、探索を細切れにして進めるのに使う。 */
+  int searchSteps(const int iteration_cnt) {
+    if (this->current_state_.isFinished()) { return 0; }
+
+    if (this->children_.size() <= 0) {
+      this->expand();
+    }
+    if (this->children_.size() == 1 && this->hasSingleLegalAction()) { return 0; }
+
+    const int start_play_cnt{this->play_cnt_};
+    for (int i = 0; i < iteration_cnt; i++) {
+      this->searchOnce();
+    }
+    return this->play_cnt_ - start_play_cnt;
+  }
+
+  /* 根用。現時点で平均得点が最も高い行動。 */
+  GameAction getBestAction() {
+    if (this->children_.size() <= 0) {
+      this->expand();
+    }
+    return this->selectChildWithBestMeanScore().last_action_;
+  }
+
+  /* 根用。is_stoppedが立つまで探索を続ける。相手の手番中の先読み(ponder)に使う。 */
+  void ponder(const std::atomic<bool>& is_stopped) {
+    if (this->current_state_.isFinished()) { return; }
+
+    if (this->children_.size() <= 0) {
+      this->expand();
+    }
+
+    while (!is_stopped.load(std::memory_order_relaxed)) {
+      this->searchOnce();
+    }
+  }
+
+  /* 根用。行動actionに対応する子節点を部分木ごと取り出す。まだ展開していなければ、統計を持たない節点を作って返す。 */
+  /* 対称な行動としてまとめられた行動の場合も、盤面の向きが異なるので統計を持たない節点を作る。 */
+  /* 取り出した後のこの節点は使えない。 */
+  MonteCarloTreeNode extractChild(const GameAction& action) {
+    auto child{std::find_if(this->children_.begin(), this->children_.end(),
+        [&action](const MonteCarloTreeNode& c) { return c.last_action_ == action; })};
+    MonteCarloTreeNode result{(child != this->children_.end()) ? std::move(*child) : this->makeChild(action)};
+    result.copySettings(*this);
+    return result;
+  }
+
+  /* 同じ局面・設定で、統計を持たない節点を作る。root並列化で乱数の系列だけ変えた木を作るのに使う。 */
+  MonteCarloTreeNode cloneEmpty(const unsigned int random_seed) const {
+    MonteCarloTreeNode result(this->current_state_, this->player_num_, this->last_action_, random_seed, this->epsilon_, this->selectForPlayout_);
+    result.rave_equivalence_ = this->rave_equivalence_;
+    result.playout_depth_ = this->playout_depth_;
+    result.evaluateForPlayout_ = this->evaluateForPlayout_;
+    result.copySettings(*this);
+    return result;
+  }
+
+  /* 同じ局面から探索した別の木の統計を、行動が一致する節点どうしで足し合わせる。 */
+  void merge(const MonteCarloTreeNode& other) {
+    this->mergeStatistics(other);
+    this->recountNodes();
+  }
+
+  /* スナップショットの統計をこの節点以下に読み込む。indexはこの節点に対応するレコードの添字。 */
+  /* スナップショットに子節点が記録されていれば展開し、行動が一致する子節点へ再帰的に統計を写す。 */
+  /* 根(index 0)から読み込むとき、スナップショットの根がこの節点と別の局面なら、何もせずにfalseを返す。 */
+  template <class Snapshot>
+  bool warmStart(const Snapshot& snapshot, const std::size_t index = 0) {
+    if (index >= snapshot.size() || (index == 0 && snapshot.header().root_key != positionKeyOf(this->current_state_))) { return false; }
+    this->loadStatistics(snapshot, index);
+    this->recountNodes();
+    return true;
+  }
+
+  GameAction getLastAction() const { return this->last_action_; }
+
+  const GameState& getState() const { return this->current_state_; }
+
+  int getPlayCount() const { return this->play_cnt_; }
+
+  const std::array<double, kNumberOfPlayers>& getSumScores() const { return this->sum_scores_; }
+
+  const std::array<double, kNumberOfPlayers>& getSumScoresSquared() const { return this->sum_scores_squared_; }
+
+  /* 子節点の配列。ワーカスレッドにNodeArenaを結び付けていれば、そのアリーナから確保する。 */
+  using Children = std::vector<MonteCarloTreeNode, NodeArenaAllocator<MonteCarloTreeNode>>;
+
+  const Children& getChildren() const { return this->children_; }
+
   /* Simulation BalancingでMinMaxの推定値を求めるのに使う。 */
   double getEstimatedMinMaxScore(const int player_num) {
     return this->selectChildWithBestMeanScore().meanScore(player_num);
@@ -72,74 +329,210 @@ class MonteCarloTreeNode {
 
  private:
   static constexpr bool kIsDebugMode{false}; // デバッグ出力あり？
-  static constexpr int kPlayoutLimit{1000};  // プレイアウト回数の制限。
+  static constexpr int kPlayoutLimit{1000};  // プレイアウト回数の制限の既定値。
   static constexpr int kExpandThreshold{3};  // 何回探索されたら節点を展開するか。
   static constexpr double kEvaluationMax{std::numeric_limits<double>::infinity()}; // 評価値の上限。
+  static constexpr double kPruneRatio{0.75}; // 刈り取り後の節点数を上限の何倍まで減らすか。
+  static constexpr int kProgressInterval{100}; // 探索の状況を何回ごとに知らせるか。
+  static constexpr int kBatchSize{64};        // searchBatched()で一度に評価する葉の数の既定値。
+  static constexpr int kEarlyStopInterval{64}; // 打ち切るかを何回ごとに確かめるか。
+  static constexpr double kEarlyStopConfidence{3.0}; // 打ち切りの信頼区間の幅の既定値。
+
+  static constexpr int kNumberOfActionIndices{numberOfActionIndices<GameState, GameAction>()};
+
+  /* RAVE用。1回のプレイアウトについて、各行動を最初に打ったプレイヤ(打たれていなければ-1)と結果を記録する。 */
+  struct AmafRecord {
+    std::array<int8_t, kNumberOfActionIndices> first_player;
+    std::array<double, kNumberOfPlayers> scores;
+  };
+
+  /* 1回の探索で得たプレイアウト結果の集計。 */
+  struct PlayoutStatistics {
+    int play_cnt{};
+    std::array<double, kNumberOfPlayers> sum_scores{};
+    std::array<double, kNumberOfPlayers> sum_scores_squared{};
+
+    void add(const std::array<double, kNumberOfPlayers>& scores) {
+      this->play_cnt++;
+      for (int i = 0; i < kNumberOfPlayers; i++) {
+        this->sum_scores.at(i) += scores.at(i);
+        this->sum_scores_squared.at(i) += scores.at(i) * scores.at(i);
+      }
+    }
+  };
 
   GameState current_state_;  // 現在の局面情報。
   int player_num_;           // 自分のプレイヤ番号。
   GameAction last_action_{}; // この節点に遷移した際の行動。
-  std::vector<MonteCarloTreeNode> children_{}; // 子節点(あり得る局面の集合)。
+  Children children_{}; // 子節点(あり得る局面の集合)。
   int play_cnt_{};                             // この節点を探索した回数。
+  int virtual_loss_{};                         // この節点を通り、評価を待っている経路の数。
   std::array<double, kNumberOfPlayers> sum_scores_{}; // この局面を通るプレイアウトで得られた各プレイヤの総得点。勝1点負0点制なら勝利数と一致する。
   std::array<double, kNumberOfPlayers> sum_scores_squared_{}; // この局面を通るプレイアウトで得られた各プレイヤの得点の二乗値の総和。
+  int amaf_play_cnt_{};                                     // RAVE用。親の手番でこの行動が打たれたプレイアウトの数。
+  std::array<double, kNumberOfPlayers> amaf_sum_scores_{};  // RAVE用。そのプレイアウトで得られた各プレイヤの総得点。
+  double rave_equivalence_{};                               // RAVEの統計を混ぜる度合い。0なら使わない。
   unsigned int random_seed_;
   XorShift64 random_engine_;
   std::function<GameAction(const GameState&, XorShift64&)> selectForPlayout_; // ロールアウトポリシー。
   float epsilon_{};
+  int playout_depth_{};     // プレイアウトを打ち切る手数。0なら終局まで打つ。
+  std::function<std::array<double, kNumberOfPlayers>(const GameState&)> evaluateForPlayout_{}; // 打ち切った局面の評価。
+  std::size_t node_cnt_{1}; // この節点を根とする部分木の節点数。
+  std::size_t node_limit_{std::numeric_limits<std::size_t>::max()}; // 根用。木全体の節点数の上限。
+  bool is_pruning_enabled_{false}; // 根用。上限に達したときに部分木を刈り取るか。
+  int playout_limit_{kPlayoutLimit}; // 根用。1回のsearch()で行うプレイアウト回数。
+  int leaf_playout_cnt_{1};          // 根用。葉に着くたびに行うプレイアウト回数。
+  EarlyStopRule early_stop_rule_{EarlyStopRule::kNone}; // 根用。探索を打ち切る条件。
+  double early_stop_z_{kEarlyStopConfidence};          // 根用。打ち切りの信頼区間の幅。
+  double saved_play_cnt_{};                           // 根用。直前の探索で省いたプレイアウト回数。
+  double saved_seconds_{};                            // 根用。直前の探索で省いた時間。
+
+  /* 根用。節点数の上限を守りながら1回探索する。 */
+  void searchOnce() {
+    SearchPhaseScope::countIteration();
+
+    /* 節点数が上限に達したら、訪問回数の少ない部分木を刈り取って空きを作る。 */
+    if (this->is_pruning_enabled_ && this->node_cnt_ >= this->node_limit_) {
+      this->prune();
+    }
+
+    const std::size_t node_room{this->node_limit_ - std::min(this->node_limit_, this->node_cnt_)};
+    if (this->rave_equivalence_ > 0.0) {
+      std::vector<AmafRecord> amaf_records{};
+      amaf_records.reserve(this->leaf_playout_cnt_);
+      this->searchChild(this->play_cnt_ + 1, node_room, this->leaf_playout_cnt_, &amaf_records);
+    } else {
+      this->searchChild(this->play_cnt_ + 1, node_room, this->leaf_playout_cnt_);
+    }
+  }
 
   /* 節点用。子節点を再帰的に掘り進め、各プレイヤの得点を逆伝播。 */
-  std::array<double, kNumberOfPlayers> searchChild(int whole_play_cnt) {
-    play_cnt_++;
+  /* node_roomは木全体であと何節点追加できるか。葉ではleaf_playout_cnt回プレイアウトし、その集計をまとめて逆伝播する。 */
+  /* amaf_recordsを渡すと(RAVE)、葉で各プレイアウトの手順を記録し、戻りながら経路上の手を書き足して兄弟節点のAMAF統計に反映する。 */
+  PlayoutStatistics searchChild(int whole_play_cnt, std::size_t node_room, const int leaf_playout_cnt,
+                                std::vector<AmafRecord>* amaf_records = nullptr) {
+    PlayoutStatistics result{};
 
-    /* 既に勝敗がついていたら、結果を返す。 */
+    /* 既に勝敗がついていたら、結果を返す。結果は決まっているので、プレイアウトと同じ回数分を数える。 */
     if (this->current_state_.isFinished()) {
-      std::array<double, kNumberOfPlayers> result{};
-      for (int i = 0; i < kNumberOfPlayers; i++) {
-        result.at(i) = this->current_state_.getScore(i);
-      }
-
-      /* 得点をmin-max正規化。 */
-      const double min_score{*std::min_element(result.begin(), result.end())};
-      const double max_score{*std::max_element(result.begin(), result.end())};
-      if (min_score == max_score) {
-        /* もし全員0点(UNOで全員が0のカードを持っている場合など)なら、正規化できないのでそのまま返す。*/
-        return result;
-      }
-      std::transform(result.begin(), result.end(), result.begin(),
-      [max_score, min_score](int score) { return (score - min_score) / (max_score - min_score); });
-
-      for (int i = 0; i < kNumberOfPlayers; i++) {
-        sum_scores_.at(i) += result.at(i);
-        sum_scores_squared_.at(i) += result.at(i) * result.at(i);
+      const std::array<double, kNumberOfPlayers> scores{finalScores(this->current_state_)};
+      for (int i = 0; i < leaf_playout_cnt; i++) {
+        result.add(scores);
+        if (amaf_records != nullptr) {
+          amaf_records->push_back(AmafRecord{});
+          amaf_records->back().first_player.fill(-1);
+          amaf_records->back().scores = scores;
+        }
       }
+      this->addStatistics(result);
       return result;
     }
 
     /* 子供がおらず、十分この節点を探索した場合は、展開する。 */
     if (this->children_.size() <= 0 &&
-        this->play_cnt_ > MonteCarloTreeNode::kExpandThreshold) {
-      this->expand();
+        this->play_cnt_ + 1 > MonteCarloTreeNode::kExpandThreshold) {
+      const SearchPhaseScope phase_scope(SearchPhase::kExpansion);
+      this->expand(node_room);
+      node_room -= this->node_cnt_ - 1;
     }
 
-    /* 子供がいる場合は、選択して掘り進める。 */
     if (this->children_.size() > 0) {
-      MonteCarloTreeNode<GameState, GameAction, kNumberOfPlayers>& child{this->selectChildToSearch(whole_play_cnt)};
-      std::array<double, kNumberOfPlayers> result{child.searchChild(whole_play_cnt)};
-      for (int i = 0; i < kNumberOfPlayers; i++) {
-        sum_scores_.at(i) += result.at(i);
-        sum_scores_squared_.at(i) += result.at(i) * result.at(i);
+      /* 子供がいる場合は、選択して掘り進める。 */
+      MonteCarloTreeNode<GameState, GameAction, kNumberOfPlayers>* selected_child{};
+      {
+        const SearchPhaseScope phase_scope(SearchPhase::kSelection);
+        selected_child = &this->selectChildToSearch(whole_play_cnt);
+      }
+      MonteCarloTreeNode<GameState, GameAction, kNumberOfPlayers>& child{*selected_child};
+      const std::size_t child_node_cnt{child.node_cnt_};
+      result = child.searchChild(whole_play_cnt, node_room, leaf_playout_cnt, amaf_records);
+      this->node_cnt_ += child.node_cnt_ - child_node_cnt;
+      if (amaf_records != nullptr) {
+        this->updateAmafStatistics(child.last_action_, *amaf_records);
+      }
+    } else {
+      /* 子供がいない場合は、プレイアウトの結果を返す。 */
+      const SearchPhaseScope phase_scope(SearchPhase::kPlayout);
+      for (int i = 0; i < leaf_playout_cnt; i++) {
+        if (amaf_records != nullptr) {
+          amaf_records->push_back(AmafRecord{});
+          AmafRecord& record{amaf_records->back()};
+          record.first_player.fill(-1);
+          record.scores = this->playout(&record);
+          result.add(record.scores);
+        } else {
+          result.add(this->playout());
+        }
       }
-      return result;
     }
 
-    /* 子供がいない場合は、プレイアウトの結果を返す。 */
-    std::array<double, kNumberOfPlayers> result{this->playout()};
+    const SearchPhaseScope phase_scope(SearchPhase::kBackpropagation);
+    this->addStatistics(result);
+    return result;
+  }
+
+  /* RAVE用。この節点で打ったactionを手順の先頭に書き足し、この節点の手番で打たれた行動に対応する子節点のAMAF統計を更新する。 */
+  void updateAmafStatistics(const GameAction& action, std::vector<AmafRecord>& amaf_records) {
+    if constexpr (has_action_index<GameState, GameAction>::value) {
+      const int8_t player_num{(int8_t)this->current_state_.getCurrentPlayerNum()};
+      for (AmafRecord& record : amaf_records) {
+        record.first_player.at(GameState::actionIndex(action)) = player_num; // 木の中の手の方が先に打たれている。
+      }
+      for (MonteCarloTreeNode& child : this->children_) {
+        const int index{GameState::actionIndex(child.last_action_)};
+        for (const AmafRecord& record : amaf_records) {
+          if (record.first_player.at(index) != player_num) { continue; }
+          child.amaf_play_cnt_++;
+          for (int i = 0; i < kNumberOfPlayers; i++) {
+            child.amaf_sum_scores_.at(i) += record.scores.at(i);
+          }
+        }
+      }
+    }
+  }
+
+  void addStatistics(const PlayoutStatistics& statistics) {
+    this->play_cnt_ += statistics.play_cnt;
     for (int i = 0; i < kNumberOfPlayers; i++) {
-      sum_scores_.at(i) += result.at(i);
-      sum_scores_squared_.at(i) += result.at(i) * result.at(i);
+      this->sum_scores_.at(i) += statistics.sum_scores.at(i);
+      this->sum_scores_squared_.at(i) += statistics.sum_scores_squared.at(i);
+    }
+  }
+
+
+  /* 根用。根から評価すべき葉までを選び、通った節点にvirtual lossをかけて経路を返す。必要なら途中で展開する。 */
+  std::vector<MonteCarloTreeNode*> selectLeaf() {
+    std::vector<MonteCarloTreeNode*> path{this};
+    this->virtual_loss_++;
+
+    MonteCarloTreeNode* node{this};
+    while (!node->current_state_.isFinished()) {
+      /* 子供がおらず、十分この節点を探索した場合は、展開する。評価待ちの分も探索した回数に数える。 */
+      if (node->children_.size() <= 0 &&
+          node->play_cnt_ + node->virtual_loss_ > MonteCarloTreeNode::kExpandThreshold) {
+        node->expand(this->node_limit_ - std::min(this->node_limit_, this->node_cnt_));
+        for (std::size_t i = 0; i + 1 < path.size(); i++) {
+          path.at(i)->node_cnt_ += node->node_cnt_ - 1;
+        }
+      }
+      if (node->children_.size() <= 0) { break; }
+
+      node = &node->selectChildToSearch(this->play_cnt_ + this->virtual_loss_);
+      node->virtual_loss_++;
+      path.push_back(node);
+    }
+    return path;
+  }
+
+  /* 経路上の節点に結果を反映し、virtual lossを外す。 */
+  static void backpropagate(const std::vector<MonteCarloTreeNode*>& path, const std::array<double, kNumberOfPlayers>& result) {
+    PlayoutStatistics statistics{};
+    statistics.add(result);
+    for (MonteCarloTreeNode* node : path) {
+      node->virtual_loss_--;
+      node->addStatistics(statistics);
     }
-    return result;
   }
 
   /* 子節点中で最も評価値の高いものを返す。 */
@@ -164,26 +557,180 @@ class MonteCarloTreeNode {
         });
   }
 
-  /* 可能な次局面すべてを子節点として追加。 */
-  void expand() {
-    std::vector<GameAction> actions{this->current_state_.legalActions()};
+  /* 根用。最善手が決まったかを確かめ、決まっていれば省ける回数と時間を記録する。 */
+  /* 残りの回数は、回数の上限と、期限までに今の速さで行える回数の小さい方。 */
+  bool isSettled(const SearchStopToken& stop_token, const std::chrono::steady_clock::time_point start_time, const int start_play_cnt) {
+    const double elapsed_seconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count()};
+    const double rate{(elapsed_seconds > 0.0) ? (this->play_cnt_ - start_play_cnt) / elapsed_seconds : 0.0};
+    const double remaining_play_cnt{std::min<double>(this->playout_limit_ - (this->play_cnt_ - start_play_cnt),
+                                                     rate * stop_token.remainingSeconds())};
+    if (!isDecisionSettled(this->children_, this->player_num_, remaining_play_cnt, this->early_stop_rule_, this->early_stop_z_)) {
+      return false;
+    }
+    this->saved_play_cnt_ = remaining_play_cnt;
+    this->saved_seconds_ = (rate > 0.0) ? remaining_play_cnt / rate : 0.0;
+    return true;
+  }
+
+  /* 根用。探索の状況をまとめる。 */
+  SearchProgress<GameAction> makeProgress(const std::chrono::steady_clock::time_point start_time, const int start_play_cnt) {
+    const MonteCarloTreeNode& best{this->selectChildWithBestMeanScore()};
+    const double elapsed_seconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count()};
+    return SearchProgress<GameAction>{
+      best.last_action_,
+      best.play_cnt_,
+      best.meanScore(this->player_num_),
+      this->play_cnt_,
+      elapsed_seconds,
+      (elapsed_seconds > 0.0) ? (this->play_cnt_ - start_play_cnt) / elapsed_seconds : 0.0
+    };
+  }
+
+  /* 行動actionを適用した局面の子節点を作る。 */
+  MonteCarloTreeNode makeChild(const GameAction& action) const {
+    GameState state{this->current_state_};
+    applyAction(state, action);
+
+    MonteCarloTreeNode child(state, state.getCurrentPlayerNum(), action, random_seed_, epsilon_, selectForPlayout_);
+    child.rave_equivalence_ = this->rave_equivalence_;
+    child.playout_depth_ = this->playout_depth_;
+    child.evaluateForPlayout_ = this->evaluateForPlayout_;
+    return child;
+  }
+
+  /* 根用の設定を写す。 */
+  void copySettings(const MonteCarloTreeNode& src) {
+    this->node_limit_ = src.node_limit_;
+    this->is_pruning_enabled_ = src.is_pruning_enabled_;
+    this->playout_limit_ = src.playout_limit_;
+    this->leaf_playout_cnt_ = src.leaf_playout_cnt_;
+    this->early_stop_rule_ = src.early_stop_rule_;
+    this->early_stop_z_ = src.early_stop_z_;
+  }
+
+  /* 可能な次局面すべてを子節点として追加。追加できる節点数がnode_roomに収まらなければ展開しない。 */
+  /* GameStateがcanonical()を持つなら、対称な局面に遷移する行動は1つの子節点にまとめる。 */
+  void expand(const std::size_t node_room = std::numeric_limits<std::size_t>::max()) {
+    std::vector<GameAction> actions{uniqueActionsUnderSymmetry(this->current_state_, legalActionsOf<GameAction>(this->current_state_))};
+    if (actions.size() > node_room) { return; }
+
     this->children_.resize(actions.size());
     std::transform(actions.begin(), actions.end(), this->children_.begin(),
-        [&](auto action) {
-          GameState state{GameState(this->current_state_).next(action)};
+        [&](auto action) { return this->makeChild(action); });
+    this->node_cnt_ = 1 + this->children_.size();
+  }
 
-          return MonteCarloTreeNode(state, state.getCurrentPlayerNum(), action, random_seed_, epsilon_, selectForPlayout_);
-        });
+  /* 根用。訪問回数の少ない展開済み節点から順に子節点を捨て、節点数をnode_limit_のkPruneRatio倍以下に減らす。 */
+  /* 子孫は必ず祖先より訪問回数が少ないので、捨てる時点でその節点の子はすべて葉になっている。 */
+  void prune() {
+    std::vector<MonteCarloTreeNode*> expanded_nodes{};
+    for (MonteCarloTreeNode& child : this->children_) {
+      child.collectExpandedNodes(expanded_nodes);
+    }
+    std::sort(expanded_nodes.begin(), expanded_nodes.end(),
+        [](const MonteCarloTreeNode* a, const MonteCarloTreeNode* b) { return a->play_cnt_ < b->play_cnt_; });
+
+    const std::size_t target_node_cnt{static_cast<std::size_t>(this->node_limit_ * MonteCarloTreeNode::kPruneRatio)};
+    std::size_t node_cnt{this->node_cnt_};
+    for (MonteCarloTreeNode* node : expanded_nodes) {
+      if (node_cnt <= target_node_cnt) { break; }
+      node_cnt -= node->children_.size();
+      Children().swap(node->children_); // 確保済みの領域ごと解放する。
+    }
+
+    this->recountNodes();
   }
 
-  /* プレイアウトを実施し、結果を返す。 */
-  std::array<double, kNumberOfPlayers> playout() {
+  /* 合法手が1つしかないか。対称な行動をまとめて子が1つになった場合と区別する。 */
+  bool hasSingleLegalAction() const { return legalActionsOf<GameAction>(this->current_state_).size() == 1; }
+
+  /* warmStart()の本体。節点数の数え直しは呼び出し元で一度だけ行う。 */
+  template <class Snapshot>
+  void loadStatistics(const Snapshot& snapshot, const std::size_t index) {
+    const auto& record{snapshot.record(index)};
+    this->play_cnt_ = record.play_cnt;
+    std::copy(record.sum_scores.begin(), record.sum_scores.end(), this->sum_scores_.begin());
+    std::copy(record.sum_scores_squared.begin(), record.sum_scores_squared.end(), this->sum_scores_squared_.begin());
+
+    if (record.child_cnt <= 0 || this->current_state_.isFinished()) { return; }
+    if (this->children_.size() <= 0) {
+      this->expand();
+    }
+    for (std::size_t i = record.first_child; i < record.first_child + record.child_cnt; i++) {
+      const GameAction action{snapshot.action(i)};
+      auto child{std::find_if(this->children_.begin(), this->children_.end(),
+          [&action](const MonteCarloTreeNode& c) { return c.last_action_ == action; })};
+      if (child != this->children_.end()) {
+        child->loadStatistics(snapshot, i);
+      }
+    }
+  }
+
+  /* merge()の本体。 */
+  void mergeStatistics(const MonteCarloTreeNode& other) {
+    this->play_cnt_ += other.play_cnt_;
+    this->amaf_play_cnt_ += other.amaf_play_cnt_;
+    for (int i = 0; i < kNumberOfPlayers; i++) {
+      this->sum_scores_.at(i) += other.sum_scores_.at(i);
+      this->sum_scores_squared_.at(i) += other.sum_scores_squared_.at(i);
+      this->amaf_sum_scores_.at(i) += other.amaf_sum_scores_.at(i);
+    }
+
+    if (other.children_.size() <= 0) { return; }
+    if (this->children_.size() <= 0) {
+      this->children_ = other.children_;
+      return;
+    }
+    for (const MonteCarloTreeNode& other_child : other.children_) {
+      auto child{std::find_if(this->children_.begin(), this->children_.end(),
+          [&other_child](const MonteCarloTreeNode& c) { return c.last_action_ == other_child.last_action_; })};
+      if (child != this->children_.end()) {
+        child->mergeStatistics(other_child);
+      }
+    }
+  }
+
+  /* 子孫のうち、展開済みの節点をすべて集める。 */
+  void collectExpandedNodes(std::vector<MonteCarloTreeNode*>& expanded_nodes) {
+    if (this->children_.size() <= 0) { return; }
+    expanded_nodes.push_back(this);
+    for (MonteCarloTreeNode& child : this->children_) {
+      child.collectExpandedNodes(expanded_nodes);
+    }
+  }
+
+  /* 部分木の節点数を数え直す。 */
+  std::size_t recountNodes() {
+    this->node_cnt_ = 1;
+    for (MonteCarloTreeNode& child : this->children_) {
+      this->node_cnt_ += child.recountNodes();
+    }
+    return this->node_cnt_;
+  }
+
+  /* プレイアウトを実施し、結果を返す。amaf_recordを渡すと、各行動を最初に打ったプレイヤを記録する。 */
+  /* playout_depth_手打って終局していなければ、その局面の評価を返す。 */
+  std::array<double, kNumberOfPlayers> playout(AmafRecord* amaf_record = nullptr) {
     GameState state{this->current_state_};
 
-    while (!state.isFinished()) {
-      state = state.next(epsilonGreedyAction(state));
+    for (int depth = 0; !state.isFinished(); depth++) {
+      if (depth == this->playout_depth_ && this->playout_depth_ > 0) {
+        return this->evaluateForPlayout_(state);
+      }
+      const GameAction action{epsilonGreedyAction(state)};
+      if constexpr (has_action_index<GameState, GameAction>::value) {
+        if (amaf_record != nullptr && amaf_record->first_player.at(GameState::actionIndex(action)) < 0) {
+          amaf_record->first_player.at(GameState::actionIndex(action)) = (int8_t)state.getCurrentPlayerNum();
+        }
+      }
+      applyAction(state, action);
     }
 
+    return finalScores(state);
+  }
+
+  /* 終局した局面の各プレイヤの得点を、Min-Max正規化して返す。 */
+  static std::array<double, kNumberOfPlayers> finalScores(const GameState& state) {
     std::array<double, kNumberOfPlayers> result{};
     for (int i = 0; i < kNumberOfPlayers; i++) {
       result.at(i) = state.getScore(i);
@@ -205,7 +752,16 @@ class MonteCarloTreeNode {
   /* なんらかの方法でplayer_num目線での現在局面の評価値を計算して返す。 */
   double evaluate(int whole_play_cnt, int player_num) const {
     // return MonteCarloTreeNode::ucb1(whole_play_cnt, this->play_cnt_, this->sum_scores_.at(player_num));
-    return MonteCarloTreeNode::ucb1Tuned(whole_play_cnt, this->play_cnt_, this->sum_scores_.at(player_num), this->sum_scores_squared_.at(player_num));
+    /* 評価待ちの経路は、負けとして数える(virtual loss)。 */
+    const int play_cnt{this->play_cnt_ + this->virtual_loss_};
+    const double ucb{MonteCarloTreeNode::ucb1Tuned(whole_play_cnt, play_cnt, this->sum_scores_.at(player_num), this->sum_scores_squared_.at(player_num))};
+    if (this->rave_equivalence_ <= 0.0 || this->amaf_play_cnt_ <= 0 || play_cnt <= 0) { return ucb; }
+
+    /* RAVE。探索回数が少ないうちは、平均得点の代わりにAMAF統計の平均得点を重く見る。探索項はそのまま足す。 */
+    const double mean{(double)this->sum_scores_.at(player_num) / play_cnt};
+    const double amaf_mean{this->amaf_sum_scores_.at(player_num) / this->amaf_play_cnt_};
+    const double beta{std::sqrt(this->rave_equivalence_ / (3.0 * play_cnt + this->rave_equivalence_))};
+    return ucb - beta * mean + beta * amaf_mean;
   }
 
   /* player_num目線での現在局面の平均得点を返す。勝ち点1負け点0のゲームなら勝率。 */
@@ -215,21 +771,21 @@ class MonteCarloTreeNode {
 
   /* ucb1値を返す。 */
   /* 得点制ゲームに対応するため、勝ち数の代わりに得点を用いている。オセロや将棋では勝ち1、負け0にすればよい。 */
-  static double ucb1(int whole_play_cnt, int play_cnt, int score) {
-    return (play_cnt <= 0) ? kEvaluationMax : (double)score / play_cnt + std::sqrt(2.0 * std::log2(whole_play_cnt) / play_cnt);
+  static double ucb1(int whole_play_cnt, int play_cnt, double score) {
+    return (play_cnt <= 0) ? kEvaluationMax : score / play_cnt + std::sqrt(2.0 * std::log2(whole_play_cnt) / play_cnt);
   }
 
   /* ucb1-tuned値を返す。 */
-  static double ucb1Tuned(int whole_play_cnt, int play_cnt, int score, int score_squared) {
-    const double mean = (double)score / play_cnt;
+  static double ucb1Tuned(int whole_play_cnt, int play_cnt, double score, double score_squared) {
+    const double mean = score / play_cnt;
     const double variance = score_squared - mean * mean;
     const double v = variance + std::sqrt(2.0 * std::log2(whole_play_cnt) / play_cnt);
-    return (play_cnt <= 0) ? kEvaluationMax : (double)score / play_cnt + std::sqrt(std::log2(whole_play_cnt) / play_cnt * std::min(0.25, v));
+    return (play_cnt <= 0) ? kEvaluationMax : score / play_cnt + std::sqrt(std::log2(whole_play_cnt) / play_cnt * std::min(0.25, v));
   }
 
   /* 与えられた局面に対してランダムな着手を選択。 */
   static GameAction randomAction(const GameState& first_state, XorShift64& random_engine) {
-    std::vector<GameAction> actions{first_state.legalActions()};
+    std::vector<GameAction> actions{legalActionsOf<GameAction>(first_state)};
     if (actions.size() == 1) { return actions.at(0); } // 一手しかないなら、それを出す。
 
     // デバッグ。7bdc5ad時点で稀にエラーが発生するのでここで出力させる。
@@ -0,0 +1,101 @@
+#ifndef MONTE_CARLO_TREE_PONDERER_HPP_
+#define MONTE_CARLO_TREE_PONDERER_HPP_
+
+#include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "monte_carlo_tree_node.hpp"
+#include "worker_placement.hpp"
+
+/* 相手の手番中に、裏のスレッドで現在局面の探索を続ける(ponder)。 */
+/* スレッドごとに別の木を持ち(root並列化)、止めたときに1つの木へまとめる。 */
+/* 各スレッドが毎回更新する根は、キャッシュラインを共有しないように並べる。 */
+template <class GameState, typename GameAction, int kNumberOfPlayers>
+class MonteCarloTreePonderer {
+ public:
+  using Node = MonteCarloTreeNode<GameState, GameAction, kNumberOfPlayers>;
+
+  explicit MonteCarloTreePonderer(const int num_threads = 1, const WorkerPoolSettings& settings = WorkerPoolSettings())
+      : num_threads_(std::max(num_threads, 1)), settings_(settings) {}
+
+  MonteCarloTreePonderer(const MonteCarloTreePonderer&) = delete;
+  MonteCarloTreePonderer& operator=(const MonteCarloTreePonderer&) = delete;
+
+  ~MonteCarloTreePonderer() { this->cancel(); }
+
+  /* rootから先読みを始める。1本目のスレッドはrootの統計を引き継ぎ、残りは乱数の系列を変えた空の木から探索する。 */
+  void start(Node root) {
+    this->cancel();
+
+    this->is_stopped_.store(false);
+    this->trees_.clear();
+    this->trees_.reserve(this->num_threads_);
+    this->trees_.push_back({std::move(root)});
+    for (int i = 1; i < this->num_threads_; i++) {
+      this->trees_.push_back({this->trees_.at(0).value.cloneEmpty(this->seed_gen_())});
+    }
+
+    for (int i = 0; i < this->num_threads_; i++) {
+      this->threads_.emplace_back([this, i]() {
+        const WorkerThreadScope worker_scope(this->settings_, i);
+        this->trees_.at(i).value.ponder(this->is_stopped_);
+      });
+    }
+  }
+
+  /* 先読みを止め、各スレッドの木をまとめた根を返す。 */
+  Node stop() {
+    assert(this->trees_.size() > 0);
+    this->join();
+    Node result{std::move(this->trees_.at(0).value)};
+    for (std::size_t i = 1; i < this->trees_.size(); i++) {
+      result.merge(this->trees_.at(i).value);
+    }
+    this->trees_.clear();
+    return result;
+  }
+
+  /* 先読みを止め、相手が指したactionに対応する部分木をまとめて返す。 */
+  Node stop(const GameAction& action) {
+    assert(this->trees_.size() > 0);
+    this->join();
+    Node result{this->trees_.at(0).value.extractChild(action)};
+    for (std::size_t i = 1; i < this->trees_.size(); i++) {
+      result.merge(this->trees_.at(i).value.extractChild(action));
+    }
+    this->trees_.clear();
+    return result;
+  }
+
+  /* 先読みを止め、結果を捨てる。 */
+  void cancel() {
+    this->join();
+    this->trees_.clear();
+  }
+
+  bool isRunning() const { return !this->threads_.empty(); }
+
+ private:
+  int num_threads_;
+  WorkerPoolSettings settings_;
+  std::atomic<bool> is_stopped_{true};
+  std::vector<CacheAligned<Node>> trees_{};
+  std::vector<std::thread> threads_{};
+  std::random_device seed_gen_{};
+
+  /* スレッドに停止を伝えて待つ。各スレッドは探索1回分で止まる。 */
+  void join() {
+    this->is_stopped_.store(true);
+    for (std::thread& thread : this->threads_) {
+      thread.join();
+    }
+    this->threads_.clear();
+  }
+};
+
+#endif // MONTE_CARLO_TREE_PONDERER_HPP_
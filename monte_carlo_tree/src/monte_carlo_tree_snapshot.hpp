@@ -0,0 +1,199 @@
+#ifndef MONTE_CARLO_TREE_SNAPSHOT_HPP_
+#define MONTE_CARLO_TREE_SNAPSHOT_HPP_
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "monte_carlo_tree_node.hpp"
+
+/* 探索木スナップショットのファイル形式。 */
+/* [MonteCarloTreeSnapshotHeader][MonteCarloTreeSnapshotRecord × node_cnt] */
+/* 節点は根を0番として幅優先順に並び、ある節点の子節点は[first_child, first_child + child_cnt)に連続して置かれる。 */
+/* 読み込み時はmmapした領域をそのままレコードの配列として扱うので、解析処理はない。 */
+/* ただし開くときに、子節点の範囲がすべてレコードの中に収まることを一度だけ確かめる。 */
+
+struct MonteCarloTreeSnapshotHeader {
+  std::array<char, 8> magic; // "MCTSNAP"
+  uint32_t version;
+  uint32_t record_size;      // レコード1つのバイト数。
+  uint32_t number_of_players;
+  uint32_t action_size;      // GameActionのバイト数。
+  uint64_t node_cnt;         // レコード数。
+  PositionKey root_key;      // 根の局面のpositionKeyOf()。
+};
+
+template <typename GameAction, int kNumberOfPlayers>
+struct MonteCarloTreeSnapshotRecord {
+  uint32_t first_child;      // 先頭の子節点の添字。
+  uint32_t child_cnt;        // 記録した子節点の数。深さの上限で打ち切った節点では0。
+  int32_t play_cnt;
+  uint32_t reserved;
+  std::array<double, kNumberOfPlayers> sum_scores;
+  std::array<double, kNumberOfPlayers> sum_scores_squared;
+  std::array<unsigned char, (sizeof(GameAction) + 7) / 8 * 8> action; // この節点に遷移した際の行動のバイト列。
+};
+
+/* mmapで読み込んだスナップショット。 */
+template <typename GameAction, int kNumberOfPlayers>
+class MonteCarloTreeSnapshot {
+ public:
+  using Record = MonteCarloTreeSnapshotRecord<GameAction, kNumberOfPlayers>;
+
+  static constexpr std::array<char, 8> kMagic{'M', 'C', 'T', 'S', 'N', 'A', 'P', '\0'};
+  static constexpr uint32_t kVersion{2};
+
+  static_assert(std::is_standard_layout<GameAction>::value && std::is_trivially_destructible<GameAction>::value,
+      "GameAction must be a plain value type to be stored in a snapshot.");
+
+  MonteCarloTreeSnapshot() = default;
+
+  MonteCarloTreeSnapshot(const MonteCarloTreeSnapshot&) = delete;
+  MonteCarloTreeSnapshot& operator=(const MonteCarloTreeSnapshot&) = delete;
+
+  MonteCarloTreeSnapshot(MonteCarloTreeSnapshot&& src) noexcept { *this = std::move(src); }
+
+  MonteCarloTreeSnapshot& operator=(MonteCarloTreeSnapshot&& src) noexcept {
+    if (this != &src) {
+      this->close();
+      std::swap(this->mapped_, src.mapped_);
+      std::swap(this->mapped_size_, src.mapped_size_);
+    }
+    return *this;
+  }
+
+  ~MonteCarloTreeSnapshot() { this->close(); }
+
+  /* ファイルをmmapする。形式が合わないか、子節点の範囲がレコードの外を指していればfalseを返す。 */
+  bool open(const std::string& path) {
+    this->close();
+
+    const int fd{::open(path.c_str(), O_RDONLY)};
+    if (fd < 0) { return false; }
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(MonteCarloTreeSnapshotHeader)) {
+      ::close(fd);
+      return false;
+    }
+
+    void* mapped{mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)};
+    ::close(fd); // mmapした領域はfdを閉じても有効。
+    if (mapped == MAP_FAILED) { return false; }
+    this->mapped_ = mapped;
+    this->mapped_size_ = st.st_size;
+
+    const MonteCarloTreeSnapshotHeader& h{this->header()};
+    /* 掛け算があふれないように、入るレコード数と比べる。 */
+    if (h.magic != kMagic || h.version != kVersion || h.record_size != sizeof(Record) ||
+        h.number_of_players != kNumberOfPlayers || h.action_size != sizeof(GameAction) || h.node_cnt <= 0 ||
+        h.node_cnt > (this->mapped_size_ - sizeof(MonteCarloTreeSnapshotHeader)) / sizeof(Record) || !this->hasValidChildRanges()) {
+      this->close();
+      return false;
+    }
+    return true;
+  }
+
+  void close() {
+    if (this->mapped_ != nullptr) {
+      munmap(this->mapped_, this->mapped_size_);
+    }
+    this->mapped_ = nullptr;
+    this->mapped_size_ = 0;
+  }
+
+  bool isOpen() const { return this->mapped_ != nullptr; }
+
+  const MonteCarloTreeSnapshotHeader& header() const {
+    return *static_cast<const MonteCarloTreeSnapshotHeader*>(this->mapped_);
+  }
+
+  std::size_t size() const { return this->isOpen() ? this->header().node_cnt : 0; }
+
+  const Record& record(const std::size_t index) const { return this->records()[index]; }
+
+  GameAction action(const std::size_t index) const {
+    GameAction action{};
+    std::memcpy(static_cast<void*>(&action), this->record(index).action.data(), sizeof(GameAction));
+    return action;
+  }
+
+ private:
+  void* mapped_{nullptr};
+  std::size_t mapped_size_{};
+
+  const Record* records() const {
+    return reinterpret_cast<const Record*>(static_cast<const char*>(this->mapped_) + sizeof(MonteCarloTreeSnapshotHeader));
+  }
+
+  /* 幅優先順なので、子節点は親より後ろにあり、レコードの中に収まる。これが成り立てば、読み込みは必ず終わり範囲外を読まない。 */
+  bool hasValidChildRanges() const {
+    const uint64_t node_cnt{this->header().node_cnt};
+    for (uint64_t i = 0; i < node_cnt; i++) {
+      const Record& r{this->records()[i]};
+      if (r.child_cnt > 0 && (r.first_child <= i || r.first_child >= node_cnt || r.child_cnt > node_cnt - r.first_child)) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+/* 探索木を根から深さmax_depthまで幅優先でスナップショットに書き出す。 */
+template <class GameState, typename GameAction, int kNumberOfPlayers>
+bool saveMonteCarloTreeSnapshot(const MonteCarloTreeNode<GameState, GameAction, kNumberOfPlayers>& root, const std::string& path,
+                                const int max_depth = std::numeric_limits<int>::max()) {
+  using Node = MonteCarloTreeNode<GameState, GameAction, kNumberOfPlayers>;
+  using Record = MonteCarloTreeSnapshotRecord<GameAction, kNumberOfPlayers>;
+
+  std::vector<Record> records{};
+  std::deque<std::pair<const Node*, int>> queue{{&root, 0}}; // 節点とその深さ。
+  while (!queue.empty()) {
+    const auto [node, depth] = queue.front();
+    queue.pop_front();
+
+    Record record{};
+    record.play_cnt = node->getPlayCount();
+    record.sum_scores = node->getSumScores();
+    record.sum_scores_squared = node->getSumScoresSquared();
+    const GameAction action{node->getLastAction()};
+    std::memcpy(record.action.data(), &action, sizeof(GameAction));
+    if (depth < max_depth) {
+      /* 子節点は、キューに先に入っている節点の子節点の直後に並ぶ。 */
+      record.first_child = records.size() + queue.size() + 1;
+      record.child_cnt = node->getChildren().size();
+      for (const Node& child : node->getChildren()) {
+        queue.emplace_back(&child, depth + 1);
+      }
+    }
+    records.push_back(record);
+  }
+
+  MonteCarloTreeSnapshotHeader header{};
+  header.magic = MonteCarloTreeSnapshot<GameAction, kNumberOfPlayers>::kMagic;
+  header.version = MonteCarloTreeSnapshot<GameAction, kNumberOfPlayers>::kVersion;
+  header.record_size = sizeof(Record);
+  header.number_of_players = kNumberOfPlayers;
+  header.action_size = sizeof(GameAction);
+  header.node_cnt = records.size();
+  header.root_key = positionKeyOf(root.getState());
+
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  ofs.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record));
+  return ofs.good();
+}
+
+#endif // MONTE_CARLO_TREE_SNAPSHOT_HPP_
@@ -0,0 +1,223 @@
+#ifndef NODE_ARENA_HPP_
+#define NODE_ARENA_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include <sys/mman.h>
+
+/* 節点の子の配列を確保する領域。ワーカスレッドにbind()して使い、確保はそのスレッドのアリーナから行う。 */
+/* 領域はkChunkSizeずつmmapし、最初に書き込むのも結び付けたスレッドなので、Linuxの既定の方針(first touch)ではそのスレッドのNUMAノードのメモリになる。 */
+/* 解放された塊はkBlockGranularityの倍数の大きさごとの空きリストで使い回し、スレッド間でロックを取り合わない。 */
+/* 他のスレッドが解放した塊は持ち主のリストにロックなしで積み、持ち主が次に空きリストを切らしたときにまとめて引き取る。 */
+/* 木はワーカより長く残ることがあるので、アリーナの領域は返さず、同じNUMAノードで次にbind()するスレッドに使い回す。 */
+class NodeArena {
+ public:
+  static constexpr std::size_t kChunkSize{2 << 20};        // 一度にmmapする大きさ。透過的ヒュージページ1枚分。
+  static constexpr std::size_t kBlockGranularity{64};      // 塊の大きさの単位。キャッシュラインの大きさ。
+  static constexpr std::size_t kMaxBlockSize{64 << 10};    // これより大きい塊は、アリーナを使わずoperator newで確保する。
+
+  explicit NodeArena(const int numa_node) : numa_node_(numa_node) {}
+
+  NodeArena(const NodeArena&) = delete;
+  NodeArena& operator=(const NodeArena&) = delete;
+
+  /* bytesバイトを確保する。スレッドにアリーナがなければoperator newで確保する。 */
+  static void* allocate(const std::size_t bytes) {
+    const std::size_t block_size{roundUp(bytes + sizeof(BlockHeader))};
+    NodeArena* arena{bound()};
+    BlockHeader* header{};
+    if (arena != nullptr && block_size <= kMaxBlockSize) {
+      header = arena->allocateBlock(block_size / kBlockGranularity);
+    } else {
+      header = static_cast<BlockHeader*>(::operator new(bytes + sizeof(BlockHeader)));
+      header->owner = nullptr;
+    }
+    return header + 1;
+  }
+
+  /* allocate()で確保した領域を、どのスレッドからでも解放できる。 */
+  static void deallocate(void* pointer) noexcept {
+    BlockHeader* header{static_cast<BlockHeader*>(pointer) - 1};
+    if (header->owner == nullptr) {
+      ::operator delete(header);
+    } else if (header->owner == bound()) {
+      header->owner->pushFree(header);
+    } else {
+      header->owner->pushRemoteFree(header);
+    }
+  }
+
+  /* このスレッドに、numa_nodeのアリーナを結び付ける。is_huge_page_enabledなら、以後mmapする領域に透過的ヒュージページを使う。 */
+  static void bind(const int numa_node, const bool is_huge_page_enabled) {
+    unbind();
+    Registry& registry{registryInstance()};
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    NodeArena* arena{};
+    for (std::size_t i = 0; i < registry.idle_arenas.size(); i++) {
+      if (registry.idle_arenas.at(i)->numa_node_ == numa_node) {
+        arena = registry.idle_arenas.at(i);
+        registry.idle_arenas.erase(registry.idle_arenas.begin() + i);
+        break;
+      }
+    }
+    if (arena == nullptr) {
+      arena = &registry.arenas.emplace_back(numa_node);
+    }
+    arena->is_huge_page_enabled_ = is_huge_page_enabled;
+    boundArena() = arena;
+  }
+
+  /* 結び付けたアリーナを、次にbind()するスレッドのために戻す。 */
+  static void unbind() {
+    NodeArena* arena{boundArena()};
+    if (arena == nullptr) { return; }
+    boundArena() = nullptr;
+    Registry& registry{registryInstance()};
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.idle_arenas.push_back(arena);
+  }
+
+  /* このスレッドに結び付けたアリーナ。なければnullptr。 */
+  static NodeArena* bound() { return boundArena(); }
+
+  /* mmapした領域の大きさ。 */
+  std::size_t getMappedBytes() const { return this->chunk_cnt_ * kChunkSize; }
+
+ private:
+  /* 塊の先頭に置く。利用者に渡す領域のアラインメントを保つため16バイトにする。 */
+  struct alignas(16) BlockHeader {
+    NodeArena* owner;     // operator newで確保したならnullptr。
+    uint32_t size_class;  // 大きさ / kBlockGranularity。
+  };
+
+  struct Registry {
+    std::mutex mutex{};
+    std::deque<NodeArena> arenas{};          // 要素の場所は変わらない。
+    std::vector<NodeArena*> idle_arenas{};  // どのスレッドにも結び付いていないアリーナ。
+  };
+
+  static constexpr std::size_t kNumberOfSizeClasses{kMaxBlockSize / kBlockGranularity + 1};
+
+  int numa_node_;
+  bool is_huge_page_enabled_{false};
+  std::size_t chunk_cnt_{};
+  char* cursor_{nullptr};  // 現在の領域の、まだ切り出していない部分の先頭。
+  char* end_{nullptr};
+  std::array<BlockHeader*, kNumberOfSizeClasses> free_lists_{};
+  std::atomic<BlockHeader*> remote_free_list_{nullptr}; // 他のスレッドが解放した塊。
+
+  static std::size_t roundUp(const std::size_t bytes) { return (bytes + kBlockGranularity - 1) / kBlockGranularity * kBlockGranularity; }
+
+  /* 空きリストでの次の塊。空いている塊の、利用者に渡す部分に置く。 */
+  static BlockHeader*& nextOf(BlockHeader* header) { return *reinterpret_cast<BlockHeader**>(header + 1); }
+
+  static NodeArena*& boundArena() {
+    static thread_local NodeArena* arena{nullptr};
+    return arena;
+  }
+
+  /* プロセスの終わりまで残す。静的な木が後から解放されても、領域が残っているように。 */
+  static Registry& registryInstance() {
+    static Registry* registry{new Registry()};
+    return *registry;
+  }
+
+  BlockHeader* allocateBlock(const uint32_t size_class) {
+    if (this->free_lists_[size_class] == nullptr && this->remote_free_list_.load(std::memory_order_relaxed) != nullptr) {
+      this->collectRemoteFree();
+    }
+
+    BlockHeader* header{this->free_lists_[size_class]};
+    if (header != nullptr) {
+      this->free_lists_[size_class] = nextOf(header);
+      return header;
+    }
+
+    const std::size_t block_size{size_class * kBlockGranularity};
+    if (this->cursor_ == nullptr || (std::size_t)(this->end_ - this->cursor_) < block_size) {
+      this->mapChunk();
+    }
+    header = reinterpret_cast<BlockHeader*>(this->cursor_);
+    this->cursor_ += block_size;
+    header->owner = this;
+    header->size_class = size_class;
+    return header;
+  }
+
+  void pushFree(BlockHeader* header) {
+    nextOf(header) = this->free_lists_[header->size_class];
+    this->free_lists_[header->size_class] = header;
+  }
+
+  void pushRemoteFree(BlockHeader* header) {
+    BlockHeader* next{this->remote_free_list_.load(std::memory_order_relaxed)};
+    do {
+      nextOf(header) = next;
+    } while (!this->remote_free_list_.compare_exchange_weak(next, header, std::memory_order_release, std::memory_order_relaxed));
+  }
+
+  /* 持ち主だけが全体を一度に取り出すので、ABA問題は起きない。 */
+  void collectRemoteFree() {
+    BlockHeader* header{this->remote_free_list_.exchange(nullptr, std::memory_order_acquire)};
+    while (header != nullptr) {
+      BlockHeader* next{nextOf(header)};
+      this->pushFree(header);
+      header = next;
+    }
+  }
+
+  /* kChunkSize境界に揃えてmmapする。切り出していない残りは捨てる。 */
+  void mapChunk() {
+    void* mapped{mmap(nullptr, 2 * kChunkSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+    if (mapped == MAP_FAILED) { throw std::bad_alloc(); }
+
+    const uintptr_t address{reinterpret_cast<uintptr_t>(mapped)};
+    const uintptr_t aligned{(address + kChunkSize - 1) / kChunkSize * kChunkSize};
+    if (aligned > address) {
+      munmap(mapped, aligned - address);
+    }
+    if (address + kChunkSize > aligned) {
+      munmap(reinterpret_cast<void*>(aligned + kChunkSize), address + kChunkSize - aligned);
+    }
+    if (this->is_huge_page_enabled_) {
+      madvise(reinterpret_cast<void*>(aligned), kChunkSize, MADV_HUGEPAGE);
+    }
+
+    this->cursor_ = reinterpret_cast<char*>(aligned);
+    this->end_ = this->cursor_ + kChunkSize;
+    this->chunk_cnt_++;
+  }
+};
+
+/* NodeArenaから確保するアロケータ。状態を持たないので、どのスレッドで作ったものも等しい。 */
+template <class T>
+struct NodeArenaAllocator {
+  using value_type = T;
+
+  NodeArenaAllocator() = default;
+
+  template <class U>
+  NodeArenaAllocator(const NodeArenaAllocator<U>&) {}
+
+  T* allocate(const std::size_t n) {
+    static_assert(alignof(T) <= 16, "NodeArena aligns blocks to 16 bytes.");
+    return static_cast<T*>(NodeArena::allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* pointer, const std::size_t) noexcept { NodeArena::deallocate(pointer); }
+
+  template <class U>
+  bool operator==(const NodeArenaAllocator<U>&) const { return true; }
+
+  template <class U>
+  bool operator!=(const NodeArenaAllocator<U>&) const { return false; }
+};
+
+#endif // NODE_ARENA_HPP_
@@ -6,6 +6,7 @@
 
 #include <iostream>
 
+#include "game_state_traits.hpp"
 #include "xorshift64.hpp"
 
 template <class GameState, typename GameAction, int kNumberOfPlayers>
@@ -17,8 +18,8 @@ class PrimitiveMonteCarloLeaf {
   PrimitiveMonteCarloLeaf(const GameAction action)
       : last_action_(action) {}
 
-  /* この葉節点から見て現在の状態からプレイアウトを実施し、結果を返す。 */
-  void playout(const GameState& current_state, std::function<GameAction(const GameState&, XorShift64&)> playout_policy) {
+  /* この葉節点から見て現在の状態からプレイアウトを実施し、結果を返す。stateはその場で書き換えながら進める。 */
+  void playout(GameState state, std::function<GameAction(const GameState&, XorShift64&)> playout_policy) {
     this->play_cnt_++;
 
     /* 乱数生成器。 */
@@ -26,9 +27,8 @@ class PrimitiveMonteCarloLeaf {
     XorShift64 random_engine{seed_gen()};
 
     /* プレイアウト。 */
-    GameState state{current_state};
     while (!state.isFinished()) {
-      state = state.next(playout_policy(state, random_engine));
+      applyAction(state, playout_policy(state, random_engine));
     }
 
     /* 評価。 */
@@ -64,6 +64,12 @@ class PrimitiveMonteCarloLeaf {
 
   GameAction getLastAction() const { return this->last_action_; }
 
+  int getPlayCount() const { return this->play_cnt_; }
+
+  const std::array<double, kNumberOfPlayers>& getSumScores() const { return this->sum_scores_; }
+
+  const std::array<double, kNumberOfPlayers>& getSumScoresSquared() const { return this->sum_scores_squared_; }
+
  private:
   static constexpr double kEvaluationMax{std::numeric_limits<double>::infinity()}; // 評価値の上限。
 
@@ -74,16 +80,16 @@ class PrimitiveMonteCarloLeaf {
 
   /* ucb1値を返す。 */
   /* 得点制ゲームに対応するため、勝ち数の代わりに得点を用いている。オセロや将棋では勝ち1、負け0にすればよい。 */
-  static double ucb1(int whole_play_cnt, int play_cnt, int score) {
-    return (play_cnt <= 0) ? kEvaluationMax : (double)score / play_cnt + std::sqrt(2.0 * std::log2(whole_play_cnt) / play_cnt);
+  static double ucb1(int whole_play_cnt, int play_cnt, double score) {
+    return (play_cnt <= 0) ? kEvaluationMax : score / play_cnt + std::sqrt(2.0 * std::log2(whole_play_cnt) / play_cnt);
   }
 
   /* ucb1-tuned値を返す。 */
-  static double ucb1Tuned(int whole_play_cnt, int play_cnt, int score, int score_squared) {
-    const double mean = (double)score / play_cnt;
+  static double ucb1Tuned(int whole_play_cnt, int play_cnt, double score, double score_squared) {
+    const double mean = score / play_cnt;
     const double variance = score_squared - mean * mean;
     const double v = variance + std::sqrt(2.0 * std::log2(whole_play_cnt) / play_cnt);
-    return (play_cnt <= 0) ? kEvaluationMax : (double)score / play_cnt + std::sqrt(std::log2(whole_play_cnt) / play_cnt * std::min(0.25, v));
+    return (play_cnt <= 0) ? kEvaluationMax : score / play_cnt + std::sqrt(std::log2(whole_play_cnt) / play_cnt * std::min(0.25, v));
   }
 };
 
@@ -2,8 +2,23 @@
 #define PRIMITIVE_MONTE_CARLO_ROOT_HPP_
 
 #include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
 
+#include "game_state_traits.hpp"
 #include "primitive_monte_carlo_leaf.hpp"
+#include "search_control.hpp"
+#include "search_executor.hpp"
+#include "search_profiler.hpp"
 
 template <class GameState, class GameObservation, class StateEstimator, typename GameAction, int kNumberOfPlayers>
 class PrimitiveMonteCarloRoot {
@@ -12,37 +27,156 @@ class PrimitiveMonteCarloRoot {
       : observation_(observation), player_num_(player_num), state_estimator_(estimator) {}
 
   GameAction search(std::function<GameAction(const GameState&, XorShift64&)> playout_policy = randomAction) {
+    return this->search(SearchStopToken(), nullptr, kProgressInterval, playout_policy);
+  }
+
+  /* stop_tokenで止められる探索。progress_interval回ごとと終了時に、探索の状況をon_progressへ渡す。 */
+  GameAction search(const SearchStopToken& stop_token, const SearchProgressCallback<GameAction>& on_progress = nullptr,
+                    const int progress_interval = kProgressInterval,
+                    std::function<GameAction(const GameState&, XorShift64&)> playout_policy = randomAction) {
     this->expand();
 
     /* 探索できない。 */
     assert(this->children_.size() > 0);
 
-    /* 手が1つしかないなら、それを出す。 */
-    if (this->children_.size() == 1) {
+    /* 手が1つしかないなら、それを出す。対称な行動をまとめて子が1つになっただけなら、その行動を評価する。 */
+    if (this->children_.size() == 1 && this->observation_.legal_actions_.size() == 1) {
       return this->children_.at(0).getLastAction();
     }
 
-    /* 評価。とりあえず、時間ではなく回数で評価回数に制限をかける。 */
-    for (int whole_play_cnt = 0; whole_play_cnt < PrimitiveMonteCarloRoot::kPlayoutLimit * (int)this->children_.size(); whole_play_cnt++) {
-      PrimitiveMonteCarloLeaf<GameState, GameAction, kNumberOfPlayers>& child{this->selectChildToSearch(whole_play_cnt)};
-      const GameState current_state{this->state_estimator_.estimate(this->observation_)}; // 現在状態を推定。
-      child.playout(current_state.next(child.getLastAction()), playout_policy);
+    if (this->is_sequential_halving_) {
+      return this->searchSequentialHalving(stop_token, on_progress, playout_policy);
+    }
+
+    /* 評価。回数の上限に達するか、停止を要求されるか、最善手が決まるまで続ける。 */
+    const auto start_time{std::chrono::steady_clock::now()};
+    const int playout_limit{PrimitiveMonteCarloRoot::kPlayoutLimit * (int)this->children_.size()};
+    this->saved_play_cnt_ = 0.0;
+    this->saved_seconds_ = 0.0;
+    const SearchScope search_scope{};
+    int whole_play_cnt{};
+    for (; whole_play_cnt < playout_limit && !stop_token.isStopRequested(); whole_play_cnt++) {
+      this->searchOnce(whole_play_cnt, playout_policy);
+      if (on_progress && (whole_play_cnt + 1) % progress_interval == 0) {
+        on_progress(this->makeProgress(start_time, whole_play_cnt + 1));
+      }
+      if (this->early_stop_rule_ != EarlyStopRule::kNone && (whole_play_cnt + 1) % PrimitiveMonteCarloRoot::kEarlyStopInterval == 0 &&
+          this->isSettled(stop_token, start_time, whole_play_cnt + 1, playout_limit)) {
+        whole_play_cnt++;
+        break;
+      }
+    }
+    if (on_progress) {
+      on_progress(this->makeProgress(start_time, whole_play_cnt));
     }
 
     /* 最善手を選んで返す。 */
     return this->selectChildWithBestMeanScore().getLastAction();
   }
 
+  /* executorのスレッドで探索し、最善手をfutureで返す。探索が終わるまでこのオブジェクトを破棄したり触ったりしてはいけない。 */
+  /* Executorは post(std::function<void()>) を持つ型(SearchExecutorなど)。要求ごとにスレッドを作らない。 */
+  template <class Executor>
+  std::future<GameAction> searchAsync(Executor& executor, const SearchStopToken& stop_token,
+                                      const SearchProgressCallback<GameAction>& on_progress = nullptr,
+                                      const int progress_interval = kProgressInterval,
+                                      std::function<GameAction(const GameState&, XorShift64&)> playout_policy = randomAction) {
+    auto promise{std::make_shared<std::promise<GameAction>>()};
+    std::future<GameAction> result{promise->get_future()};
+    executor.post([this, promise, stop_token, on_progress, progress_interval, playout_policy]() {
+      try {
+        promise->set_value(this->search(stop_token, on_progress, progress_interval, playout_policy));
+      } catch (...) {
+        promise->set_exception(std::current_exception());
+      }
+    });
+    return result;
+  }
+
+  /* 探索をiteration_cnt回だけ進め、行ったプレイアウト回数を返す。手が1つしかなく、探索の必要がなければ0を返す。 */
+  /* search()と違い、前回までの統計を引き継ぐ。MonteCarloSearchSchedulerのように、探索を細切れにして進めるのに使う。 */
+  int searchSteps(const int iteration_cnt, std::function<GameAction(const GameState&, XorShift64&)> playout_policy = randomAction) {
+    if (this->children_.size() <= 0) {
+      this->expand();
+    }
+    if (this->children_.size() == 1 && this->observation_.legal_actions_.size() == 1) { return 0; }
+
+    int whole_play_cnt{std::accumulate(this->children_.begin(), this->children_.end(), 0,
+        [](const int sum, const auto& child) { return sum + child.getPlayCount(); })};
+    for (int i = 0; i < iteration_cnt; i++, whole_play_cnt++) {
+      this->searchOnce(whole_play_cnt, playout_policy);
+    }
+    return iteration_cnt;
+  }
+
+  /* 現時点で平均得点が最も高い行動。 */
+  GameAction getBestAction() {
+    if (this->children_.size() <= 0) {
+      this->expand();
+    }
+    return this->selectChildWithBestMeanScore().getLastAction();
+  }
+
+  /* 最善手が決まった時点で探索を打ち切る条件を設定する。逐次半減では使わない。zはEarlyStopRule::kConfidenceでの信頼区間の幅。 */
+  void setEarlyStop(const EarlyStopRule rule, const double z = kEarlyStopConfidence) {
+    this->early_stop_rule_ = rule;
+    this->early_stop_z_ = z;
+  }
+
+  /* 直前のsearch()で打ち切りにより省いたプレイアウト回数。期限つきの探索では、残り時間に今の速さで行えた回数で見積もる。 */
+  double getSavedPlayoutCount() const { return this->saved_play_cnt_; }
+
+  /* 直前のsearch()で打ち切りにより省いた時間(秒)の見積もり。 */
+  double getSavedSeconds() const { return this->saved_seconds_; }
+
+  /* 逐次半減(sequential halving)で探索するかを切り替える。 */
+  /* 全体でplayout_budget回(0ならkPlayoutLimit×子節点数)のプレイアウトを、残っている行動に均等に配っては下位半分を捨てることを、1つになるまで繰り返す。 */
+  /* 各ラウンドの行動ごとのプレイアウトは互いに独立なので、executorがあればそのスレッドと呼び出したスレッドで分けて行う。 */
+  /* 各スレッドは状態推定器の複製を使う。executorは探索が終わるまで破棄してはいけない。 */
+  void setSequentialHalving(const bool is_enabled, const int playout_budget = 0, SearchExecutor* executor = nullptr) {
+    this->is_sequential_halving_ = is_enabled;
+    this->playout_budget_ = std::max(playout_budget, 0);
+    this->executor_ = executor;
+  }
+
+  /* 直前の探索での子節点。 */
+  const std::vector<PrimitiveMonteCarloLeaf<GameState, GameAction, kNumberOfPlayers>>& getChildren() const { return this->children_; }
+
  private:
   static constexpr int kPlayoutLimit{1000};  // プレイアウト回数の制限。
+  static constexpr int kProgressInterval{100}; // 探索の状況を何回ごとに知らせるか。
+  static constexpr int kEarlyStopInterval{64}; // 打ち切るかを何回ごとに確かめるか。
+  static constexpr double kEarlyStopConfidence{3.0}; // 打ち切りの信頼区間の幅の既定値。
 
   GameObservation observation_; // 現在の局面情報。
   int player_num_;              // 自分のプレイヤ番号。
   StateEstimator state_estimator_;
+  bool is_sequential_halving_{false}; // 逐次半減で探索するか。
+  int playout_budget_{};              // 逐次半減での全体のプレイアウト回数。0ならkPlayoutLimit×子節点数。
+  SearchExecutor* executor_{nullptr}; // 逐次半減で1ラウンドのプレイアウトを分けて行うスレッド。なければ呼び出したスレッドだけで行う。
+  EarlyStopRule early_stop_rule_{EarlyStopRule::kNone}; // 探索を打ち切る条件。
+  double early_stop_z_{kEarlyStopConfidence};          // 打ち切りの信頼区間の幅。
+  double saved_play_cnt_{};                           // 直前の探索で省いたプレイアウト回数。
+  double saved_seconds_{};                            // 直前の探索で省いた時間。
   std::vector<PrimitiveMonteCarloLeaf<GameState, GameAction, kNumberOfPlayers>> children_{}; // 子節点(あり得る局面の集合)。
 
+  /* 子節点を1つ選んでプレイアウトする。 */
+  void searchOnce(const int whole_play_cnt, const std::function<GameAction(const GameState&, XorShift64&)>& playout_policy) {
+    SearchPhaseScope::countIteration();
+
+    PrimitiveMonteCarloLeaf<GameState, GameAction, kNumberOfPlayers>* child{};
+    {
+      const SearchPhaseScope phase_scope(SearchPhase::kSelection);
+      child = &this->selectChildToSearch(whole_play_cnt);
+    }
+    const SearchPhaseScope phase_scope(SearchPhase::kPlayout);
+    GameState state{this->state_estimator_.estimate(this->observation_)}; // 現在状態を推定。
+    applyAction(state, child->getLastAction());
+    child->playout(std::move(state), playout_policy);
+  }
+
   static GameAction randomAction(const GameState& first_state, XorShift64& random_engine) {
-    std::vector<GameAction> actions{first_state.legalActions()};
+    std::vector<GameAction> actions{legalActionsOf<GameAction>(first_state)};
     if (actions.size() == 1) { return actions.at(0); } // 一手しかないなら、それを出す。
 
     // デバッグ。7bdc5ad時点で稀にエラーが発生するのでここで出力させる。
@@ -58,7 +192,8 @@ class PrimitiveMonteCarloRoot {
   /* 可能な次局面すべてを子節点として追加。 */
   void expand() {
     /* 子節点を作る。不完全情報ゲームで探索毎に状態を推定する場合のために、葉には状態を持たせない。 */
-    const std::vector<GameAction> actions{this->observation_.legal_actions_};
+    /* GameStateがcanonical()を持つ(完全情報ゲームの)場合は、対称な局面に遷移する行動を1つの葉にまとめる。 */
+    const std::vector<GameAction> actions{uniqueActionsUnderSymmetry(this->state_estimator_.estimate(this->observation_), this->observation_.legal_actions_)};
     this->children_.resize(actions.size());
     std::transform(actions.begin(), actions.end(), this->children_.begin(),
         [&](auto action) {
@@ -66,6 +201,135 @@ class PrimitiveMonteCarloRoot {
         });
   }
 
+  /* 最善手が決まったかを確かめ、決まっていれば省ける回数と時間を記録する。 */
+  bool isSettled(const SearchStopToken& stop_token, const std::chrono::steady_clock::time_point start_time, const int whole_play_cnt, const int playout_limit) {
+    const double elapsed_seconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count()};
+    const double rate{(elapsed_seconds > 0.0) ? whole_play_cnt / elapsed_seconds : 0.0};
+    const double remaining_play_cnt{std::min<double>(playout_limit - whole_play_cnt, rate * stop_token.remainingSeconds())};
+    if (!isDecisionSettled(this->children_, this->player_num_, remaining_play_cnt, this->early_stop_rule_, this->early_stop_z_)) {
+      return false;
+    }
+    this->saved_play_cnt_ = remaining_play_cnt;
+    this->saved_seconds_ = (rate > 0.0) ? remaining_play_cnt / rate : 0.0;
+    return true;
+  }
+
+  /* runBatches()で、組を取り合うスレッドの間で共有する状態。 */
+  struct BatchRound {
+    std::function<int(int)> run_batch;
+    int batch_cnt;
+    std::atomic<int> next_batch{0};
+    std::mutex mutex{};
+    std::condition_variable condition{};
+    int finished_cnt{}; // mutexを取って変える。
+    int play_cnt{};     // mutexを取って変える。
+  };
+
+  /* run_batch(0)〜run_batch(batch_cnt - 1)をexecutor_のスレッドと呼び出したスレッドで分けて行い、返り値の合計を返す。 */
+  /* 呼び出したスレッドも残りの組を取って進め、他のスレッドが始めた組だけを待つ。探索自体がexecutor_の上で動いていても止まらない。 */
+  /* 全部の組が取られた後に始まったタスクは、何もせずに終わる。 */
+  int runBatches(const int batch_cnt, std::function<int(int)> run_batch) {
+    const auto round{std::make_shared<BatchRound>()};
+    round->run_batch = std::move(run_batch);
+    round->batch_cnt = batch_cnt;
+    const auto drain{[](BatchRound& r) {
+      for (int t = r.next_batch++; t < r.batch_cnt; t = r.next_batch++) {
+        const int play_cnt{r.run_batch(t)};
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.play_cnt += play_cnt;
+        r.finished_cnt++;
+        r.condition.notify_all();
+      }
+    }};
+
+    if (this->executor_ != nullptr) {
+      for (int t = 1; t < batch_cnt; t++) {
+        this->executor_->post([round, drain]() { drain(*round); });
+      }
+    }
+    drain(*round);
+
+    std::unique_lock<std::mutex> lock(round->mutex);
+    round->condition.wait(lock, [&round]() { return round->finished_cnt >= round->batch_cnt; });
+    return round->play_cnt;
+  }
+
+  /* 逐次半減での探索。各ラウンドでは、残っている行動すべてに同じ回数のプレイアウトを行い、平均得点の上位半分を残す。 */
+  GameAction searchSequentialHalving(const SearchStopToken& stop_token, const SearchProgressCallback<GameAction>& on_progress,
+                                     std::function<GameAction(const GameState&, XorShift64&)> playout_policy) {
+    const auto start_time{std::chrono::steady_clock::now()};
+    const int budget{(this->playout_budget_ > 0) ? this->playout_budget_ : PrimitiveMonteCarloRoot::kPlayoutLimit * (int)this->children_.size()};
+    int round_cnt{};
+    for (std::size_t n = this->children_.size(); n > 1; n = (n + 1) / 2) {
+      round_cnt++;
+    }
+
+    /* 止められてプレイアウトしていない行動は、最も低く見る。 */
+    const auto score{[this](const std::size_t i) {
+      const PrimitiveMonteCarloLeaf<GameState, GameAction, kNumberOfPlayers>& child{this->children_.at(i)};
+      return (child.getPlayCount() > 0) ? child.meanScore(this->player_num_) : -std::numeric_limits<double>::infinity();
+    }};
+
+    std::vector<std::size_t> candidates(this->children_.size());
+    std::iota(candidates.begin(), candidates.end(), 0);
+    int whole_play_cnt{};
+    while (candidates.size() > 1 && !stop_token.isStopRequested()) {
+      const int playouts_per_action{std::max(budget / (int)(candidates.size() * round_cnt), 1)};
+
+      /* 行動を組に分けて振り分ける。葉は組ごとに別なので、統計の更新はぶつからない。 */
+      const int thread_cnt{(this->executor_ == nullptr) ? 1 : this->executor_->getThreadCount() + 1};
+      const int batch_cnt{std::min(thread_cnt, (int)candidates.size())};
+      whole_play_cnt += this->runBatches(batch_cnt, [&](const int t) {
+        StateEstimator estimator{this->state_estimator_};
+        int play_cnt{};
+        for (std::size_t i = t; i < candidates.size(); i += batch_cnt) {
+          PrimitiveMonteCarloLeaf<GameState, GameAction, kNumberOfPlayers>& child{this->children_.at(candidates.at(i))};
+          for (int k = 0; k < playouts_per_action && !stop_token.isStopRequested(); k++) {
+            GameState state{estimator.estimate(this->observation_)}; // 現在状態を推定。
+            applyAction(state, child.getLastAction());
+            child.playout(std::move(state), playout_policy);
+            play_cnt++;
+          }
+        }
+        return play_cnt;
+      });
+
+      /* 途中で止められたラウンドは行動ごとの回数がそろっていないので、それで半分に絞らない。 */
+      if (stop_token.isStopRequested()) {
+        if (on_progress) {
+          on_progress(this->makeProgress(start_time, whole_play_cnt));
+        }
+        break;
+      }
+
+      /* 平均得点の上位半分を残す。 */
+      std::sort(candidates.begin(), candidates.end(), [&score](const std::size_t a, const std::size_t b) { return score(a) > score(b); });
+      candidates.resize((candidates.size() + 1) / 2);
+
+      if (on_progress) {
+        on_progress(this->makeProgress(start_time, whole_play_cnt));
+      }
+    }
+
+    /* 止められた場合も、残っている中でプレイアウトした行動のうち、最も平均得点の高いものを選ぶ。 */
+    return this->children_.at(*std::max_element(candidates.begin(), candidates.end(),
+        [&score](const std::size_t a, const std::size_t b) { return score(a) < score(b); })).getLastAction();
+  }
+
+  /* 探索の状況をまとめる。 */
+  SearchProgress<GameAction> makeProgress(const std::chrono::steady_clock::time_point start_time, const int whole_play_cnt) {
+    const PrimitiveMonteCarloLeaf<GameState, GameAction, kNumberOfPlayers>& best{this->selectChildWithBestMeanScore()};
+    const double elapsed_seconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count()};
+    return SearchProgress<GameAction>{
+      best.getLastAction(),
+      best.getPlayCount(),
+      best.meanScore(this->player_num_),
+      whole_play_cnt,
+      elapsed_seconds,
+      (elapsed_seconds > 0.0) ? whole_play_cnt / elapsed_seconds : 0.0
+    };
+  }
+
   /* 子節点中で最も評価値の高いものを返す。 */
   PrimitiveMonteCarloLeaf<GameState, GameAction, kNumberOfPlayers>& selectChildToSearch(int whole_play_cnt) {
     assert(this->children_.size() > 0);
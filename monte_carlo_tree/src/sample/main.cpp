@@ -1,12 +1,78 @@
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
 #include <random>
 #include <string.h>
 #include <iostream>
+#include <thread>
 
 #include "../primitive_monte_carlo_root.hpp"
 #include "../monte_carlo_tree_node.hpp"
+#include "../monte_carlo_tree_ponderer.hpp"
+#include "othello_benchmark.hpp"
+#include "othello_book.hpp"
+#include "othello_engine.hpp"
 #include "othello_observation.hpp"
+#include "othello_pattern_evaluator.hpp"
+#include "othello_rollout_policy.hpp"
+#include "othello_selfplay.hpp"
+#include "othello_simulation_balancing.hpp"
 #include "othello_state.hpp"
 #include "othello_state_estimator.hpp"
+#include "othello_test_suite.hpp"
+
+constexpr char kBookPath[]{"out/othello_book.bin"}; // 定石ファイルの既定の置き場所。
+constexpr int kBookPlayoutLimit{20000}; // 定石作成時の1局面あたりのプレイアウト回数。
+
+constexpr char kSelfPlayPath[]{"out/othello_selfplay.bin"}; // 自己対局の棋譜の既定の置き場所。
+constexpr int kSelfPlayPlayoutLimit{1000}; // 自己対局での1手あたりのプレイアウト回数。
+constexpr char kRolloutPolicyPath[]{"out/othello_rollout.bin"}; // プレイアウト方策の重みファイルの既定の置き場所。
+constexpr char kPatternPath[]{"out/othello_pattern.bin"}; // パターン評価器の重みファイルの既定の置き場所。
+constexpr int kTruncatedPlayoutDepth{4}; // パターン評価器があるとき、プレイアウトを何手で打ち切るか。
+
+/* 定石。ファイルがあればmain()で開く。 */
+OthelloBook book{};
+
+/* プレイアウト方策。重みファイルがあればmain()で読み込み、なければランダムにプレイアウトする。 */
+std::shared_ptr<const OthelloRolloutPolicy> rollout_policy{};
+
+/* パターン評価器。重みファイルがあればmain()で読み込み、プレイアウトをkTruncatedPlayoutDepth手で打ち切って評価する。 */
+std::shared_ptr<const OthelloPatternEvaluator> pattern_evaluator{};
+
+/* 探索木の根を作る。プレイアウト方策やパターン評価器があれば使う。 */
+MonteCarloTreeNode<OthelloState, coord, 2> makeTree(const OthelloState& state, const unsigned int seed) {
+  MonteCarloTreeNode<OthelloState, coord, 2> tree{(rollout_policy == nullptr)
+      ? MonteCarloTreeNode<OthelloState, coord, 2>(state, state.getCurrentPlayerNum(), {-1, -1}, seed)
+      : MonteCarloTreeNode<OthelloState, coord, 2>(state, state.getCurrentPlayerNum(), {-1, -1}, seed, 0.0,
+                                                   OthelloRolloutPolicy::asPlayoutPolicy(rollout_policy))};
+  if (pattern_evaluator != nullptr) {
+    tree.setTruncatedPlayout(kTruncatedPlayoutDepth, OthelloPatternEvaluator::asPlayoutEvaluator(pattern_evaluator));
+  }
+  return tree;
+}
+
+/* 0以上の整数として全体を読めればvalueに入れてtrueを返す。 */
+bool parseNonNegativeInt(const char* str, int& value) {
+  char* end{};
+  errno = 0;
+  const long result{std::strtol(str, &end, 10)};
+  if (end == str || *end != '\0' || errno == ERANGE || result < 0 || result > INT_MAX) { return false; }
+  value = (int)result;
+  return true;
+}
+
+/* 正の有限な実数として全体を読めればvalueに入れてtrueを返す。 */
+bool parsePositiveDouble(const char* str, double& value) {
+  char* end{};
+  errno = 0;
+  const double result{std::strtod(str, &end)};
+  if (end == str || *end != '\0' || errno == ERANGE || !std::isfinite(result) || result <= 0.0) { return false; }
+  value = result;
+  return true;
+}
 
 coord getPlayerInput(const OthelloState& state) {
   std::cout << "石を置く場所を指定してください。" << std::endl;
@@ -29,25 +95,43 @@ coord getPlayerInput(const OthelloState& state) {
 }
 
 coord getPMCInput(const OthelloState& state) {
+  /* 定石にある局面なら探索しない。 */
+  coord book_action{};
+  if (book.lookup(state, book_action)) { return book_action; }
+
   std::random_device seed_gen; // 乱数のシード生成器。
   OthelloStateEstimator estimator{}; // 状態推定器。オセロは完全情報ゲームなので、形だけ。
 
   PrimitiveMonteCarloRoot<OthelloState, OthelloObservation, OthelloStateEstimator, coord, 2> node =
       PrimitiveMonteCarloRoot<OthelloState, OthelloObservation, OthelloStateEstimator, coord, 2>
       (state.getObservation(), estimator, state.getCurrentPlayerNum());
+  if (rollout_policy != nullptr) {
+    return node.search(OthelloRolloutPolicy::asPlayoutPolicy(rollout_policy));
+  }
   return node.search();
 }
 
 coord getMCTSInput(const OthelloState& state) {
+  /* 定石にある局面なら探索しない。 */
+  coord book_action{};
+  if (book.lookup(state, book_action)) { return book_action; }
+
   /* 乱数のシード生成器。 */
   std::random_device seed_gen;
 
-  MonteCarloTreeNode<OthelloState, coord, 2> node =
-      MonteCarloTreeNode<OthelloState, coord, 2>
-      (state, state.getCurrentPlayerNum(), {-1, -1}, seed_gen());
+  MonteCarloTreeNode<OthelloState, coord, 2> node{makeTree(state, seed_gen())};
   return node.search();
 }
 
+/* 前の手番から持ち越した木で探索を続ける。 */
+coord getMCTSInput(const OthelloState& state, MonteCarloTreeNode<OthelloState, coord, 2>& tree) {
+  /* 定石にある局面なら探索しない。 */
+  coord book_action{};
+  if (book.lookup(state, book_action)) { return book_action; }
+
+  return tree.search();
+}
+
 void pvp() {
   OthelloState state{};
   while (!state.isFinished()) {
@@ -72,10 +156,15 @@ void pvp() {
   }
 }
 
-void monte_carlo() {
+/* is_mctsならモンテカルロ木探索で対戦する。木は手番をまたいで持ち越し、プレイヤの手番中も裏で先読みする。 */
+void monte_carlo(const bool is_mcts) {
   /* ゲームの状態。 */
   OthelloState state{};
 
+  std::random_device seed_gen;
+  MonteCarloTreeNode<OthelloState, coord, 2> tree{makeTree(state, seed_gen())};
+  MonteCarloTreePonderer<OthelloState, coord, 2> ponderer{(int)std::thread::hardware_concurrency()};
+
   int player_color;
   int tmp;
   std::cout << "0:先攻 or 1:後攻" << std::endl;
@@ -103,9 +192,16 @@ void monte_carlo() {
 
     state.print();
     coord action{};
-    if (state.getCurrentPlayerNum() != player_color) {
+    if (state.getCurrentPlayerNum() != player_color && is_mcts) {
+      action = getMCTSInput(state, tree);
+      tree = tree.extractChild(action);
+    } else if (state.getCurrentPlayerNum() != player_color) {
       action = getPMCInput(state);
       // action = getMCTSInput(state);
+    } else if (is_mcts) {
+      ponderer.start(std::move(tree));
+      action = getPlayerInput(state);
+      tree = ponderer.stop(action);
     } else {
       action = getPlayerInput(state);
     }
@@ -123,14 +219,138 @@ void monte_carlo() {
 }
 
 int main(int argc, char* argv[]) {
+  /* 回数や手数を取るオプションで、数として読めない値を渡されたときの出力。 */
+  const auto invalidNumber{[](const char* str) {
+    std::cout << "0以上の整数を指定してください: " << str << std::endl;
+    return 1;
+  }};
+
+  /* -b 手数 [ファイル名]: 定石を作って終了する。 */
+  if (argc > 2 && strcmp(argv[1], "-b") == 0) {
+    const std::string path{(argc > 3) ? argv[3] : kBookPath};
+    int max_plies{};
+    if (!parseNonNegativeInt(argv[2], max_plies)) { return invalidNumber(argv[2]); }
+    const bool is_built{OthelloBook::build(path, max_plies, kBookPlayoutLimit, std::thread::hardware_concurrency())};
+    std::cout << (is_built ? "定石を作成しました: " : "定石を作成できませんでした: ") << path << std::endl;
+    return is_built ? 0 : 1;
+  }
+
+  /* -bench 名前: ベンチマークを実行して終了する。 */
+  if (argc > 2 && strcmp(argv[1], "-bench") == 0) {
+    if (!runBenchmark(argv[2], std::cout)) {
+      std::cout << "ベンチマークが見つかりません: " << argv[2] << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  /* -t 反復回数 [ファイル名]: プレイアウト方策をSimulation Balancingで学習して終了する。 */
+  if (argc > 2 && strcmp(argv[1], "-t") == 0) {
+    const std::string path{(argc > 3) ? argv[3] : kRolloutPolicyPath};
+    SimulationBalancingSettings settings{};
+    if (!parseNonNegativeInt(argv[2], settings.iteration_cnt)) { return invalidNumber(argv[2]); }
+    settings.num_threads = std::thread::hardware_concurrency();
+    OthelloRolloutPolicy policy{};
+    trainRolloutPolicy(policy, settings, std::cout);
+    const bool is_saved{policy.save(path)};
+    std::cout << (is_saved ? "プレイアウト方策を保存しました: " : "プレイアウト方策を保存できませんでした: ") << path << std::endl;
+    return is_saved ? 0 : 1;
+  }
+
+  /* -pt 周回数 [棋譜ファイル名]: 自己対局の棋譜からパターン評価器の重みを学習して終了する。 */
+  if (argc > 2 && strcmp(argv[1], "-pt") == 0) {
+    const std::string path{(argc > 3) ? argv[3] : kSelfPlayPath};
+    PatternTrainingSettings settings{};
+    if (!parseNonNegativeInt(argv[2], settings.epoch_cnt)) { return invalidNumber(argv[2]); }
+    OthelloSelfPlayReader reader{};
+    if (!reader.open(path)) {
+      std::cout << "棋譜を読み込めませんでした: " << path << std::endl;
+      return 1;
+    }
+    OthelloPatternEvaluator evaluator{};
+    trainPatternEvaluator(evaluator, reader, settings, std::cout);
+    const bool is_saved{evaluator.save(kPatternPath)};
+    std::cout << (is_saved ? "パターン評価器を保存しました: " : "パターン評価器を保存できませんでした: ") << kPatternPath << std::endl;
+    return is_saved ? 0 : 1;
+  }
+
+  /* -s 対局数 [ファイル名]: 自己対局の棋譜を作って終了する。 */
+  if (argc > 2 && strcmp(argv[1], "-s") == 0) {
+    const std::string path{(argc > 3) ? argv[3] : kSelfPlayPath};
+    int game_cnt{};
+    if (!parseNonNegativeInt(argv[2], game_cnt)) { return invalidNumber(argv[2]); }
+    std::random_device seed_gen;
+    if (!generateSelfPlay(path, game_cnt, kSelfPlayPlayoutLimit, std::thread::hardware_concurrency(), seed_gen(), std::cout)) {
+      std::cout << "棋譜を作成できませんでした: " << path << std::endl;
+      return 1;
+    }
+
+    /* 書き出した棋譜を読み直して、局面数と黒の勝率を確かめる。 */
+    OthelloSelfPlayReader reader{};
+    if (!reader.open(path)) {
+      std::cout << "棋譜を読み込めませんでした: " << path << std::endl;
+      return 1;
+    }
+    const std::size_t black_win_cnt{(std::size_t)std::count_if(reader.begin(), reader.end(),
+        [](const OthelloSelfPlayRecord& record) { return record.black_disk_diff > 0; })};
+    std::cout << "棋譜を作成しました: " << path << " (" << reader.size() << "局面, 黒の勝ち局面の割合 "
+              << (double)black_win_cnt / std::max<std::size_t>(reader.size(), 1) << ")" << std::endl;
+    return 0;
+  }
+
+  book.open(kBookPath);
+
+  OthelloRolloutPolicy policy{};
+  if (policy.load(kRolloutPolicyPath)) {
+    rollout_policy = std::make_shared<const OthelloRolloutPolicy>(policy);
+  }
+
+  OthelloPatternEvaluator evaluator{};
+  if (evaluator.load(kPatternPath)) {
+    pattern_evaluator = std::make_shared<const OthelloPatternEvaluator>(std::move(evaluator));
+  }
+
+  /* -e: 標準入出力のコマンドで操作する思考エンジンとして動く。 */
+  if (argc > 1 && strcmp(argv[1], "-e") == 0) {
+    OthelloEngine engine(std::cin, std::cout, book);
+    engine.run();
+    return 0;
+  }
+
+  /* -ts ファイル名 [mcts|pmc|solve] [1局面あたりの秒数]: 局面集を解いて、正解にたどり着くまでの時間と回数を出力して終了する。 */
+  if (argc > 2 && strcmp(argv[1], "-ts") == 0) {
+    std::vector<OthelloTestPosition> positions{};
+    if (!loadTestPositions(argv[2], positions)) {
+      std::cout << "局面集を読み込めませんでした: " << argv[2] << std::endl;
+      return 1;
+    }
+    TestSuiteSettings settings{};
+    if (argc > 3 && !parseTestSuiteMethod(argv[3], settings.method)) {
+      std::cout << "探索の方法が見つかりません: " << argv[3] << std::endl;
+      return 1;
+    }
+    if (argc > 4 && !parsePositiveDouble(argv[4], settings.seconds)) {
+      std::cout << "1局面あたりの秒数には正の数を指定してください: " << argv[4] << std::endl;
+      return 1;
+    }
+    settings.num_threads = std::thread::hardware_concurrency();
+    settings.rollout_policy = rollout_policy;
+    settings.pattern_evaluator = pattern_evaluator;
+    settings.truncated_playout_depth = kTruncatedPlayoutDepth;
+    runTestSuite(positions, settings, std::cout);
+    return 0;
+  }
+
   bool is_pvp{false};
+  bool is_mcts{false};
   if (argc > 1) {
     is_pvp = strcmp(argv[1], "-p") == 0;
+    is_mcts = strcmp(argv[1], "-m") == 0;
   }
 
   if (is_pvp) {
     pvp();
   } else {
-    monte_carlo();
+    monte_carlo(is_mcts);
   }
 }
@@ -0,0 +1,497 @@
+#include "othello_benchmark.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../monte_carlo_process_search.hpp"
+#include "../monte_carlo_search_scheduler.hpp"
+#include "../monte_carlo_tree_node.hpp"
+#include "../monte_carlo_tree_ponderer.hpp"
+#include "../primitive_monte_carlo_root.hpp"
+#include "../search_profiler.hpp"
+#include "../worker_placement.hpp"
+#include "othello_evaluator.hpp"
+#include "othello_pattern_evaluator.hpp"
+#include "othello_state.hpp"
+#include "othello_state_estimator.hpp"
+
+namespace {
+
+constexpr int kBenchmarkPlayoutLimit{40000}; // 1回の計測で使うプレイアウト回数。
+constexpr int kOpeningPlies{10};             // 計測に使う局面の手数。
+
+constexpr char kPatternPath[]{"out/othello_pattern.bin"}; // パターン評価器の重みファイル。
+
+/* 初期局面から固定した乱数でkOpeningPlies手進めた局面。 */
+OthelloState benchmarkPosition() {
+  XorShift64 random_engine{1};
+  OthelloState state{};
+  for (int i = 0; i < kOpeningPlies && !state.isFinished(); i++) {
+    const std::vector<coord> actions{state.legalActions()};
+    state = state.next(actions.at(random_engine() % actions.size()));
+  }
+  return state;
+}
+
+/* 葉ごとのプレイアウト回数を変えて、同じプレイアウト回数での探索時間を比べる。 */
+void benchmarkLeafParallel(std::ostream& os) {
+  const OthelloState state{benchmarkPosition()};
+  double base_seconds{};
+
+  os << "leaf_playouts  tree_walks  nodes  seconds  playouts/s  speedup" << std::endl;
+  for (const int leaf_playout_cnt : {1, 2, 4, 8, 16, 32}) {
+    MonteCarloTreeNode<OthelloState, coord, 2> node(state, state.getCurrentPlayerNum(), {-1, -1}, 1);
+    node.setPlayoutLimit(kBenchmarkPlayoutLimit);
+    node.setLeafPlayoutCount(leaf_playout_cnt);
+
+    const auto start_time{std::chrono::steady_clock::now()};
+    node.search();
+    const double seconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count()};
+    if (leaf_playout_cnt == 1) {
+      base_seconds = seconds;
+    }
+
+    os << std::setw(13) << leaf_playout_cnt
+       << std::setw(12) << node.getPlayCount() / leaf_playout_cnt
+       << std::setw(7) << node.getNodeCount()
+       << std::setw(9) << std::fixed << std::setprecision(3) << seconds
+       << std::setw(12) << std::setprecision(0) << node.getPlayCount() / seconds
+       << std::setw(9) << std::setprecision(2) << base_seconds / seconds << std::endl;
+  }
+}
+
+/* プロセス数を変えて、1プロセスあたり同じプレイアウト回数の探索を並べたときの処理量を比べる。 */
+void benchmarkProcessParallel(std::ostream& os) {
+  using Node = MonteCarloTreeNode<OthelloState, coord, 2>;
+  const OthelloState state{benchmarkPosition()};
+  const int max_processes{std::max((int)std::thread::hardware_concurrency(), 1)};
+  double base_rate{};
+
+  os << "processes  playouts  failed  seconds  playouts/s  speedup  best" << std::endl;
+  for (int num_processes = 1; num_processes <= max_processes; num_processes *= 2) {
+    MonteCarloProcessSearch<coord, 2> search(num_processes);
+    const auto start_time{std::chrono::steady_clock::now()};
+    search.search<Node>([&state](const int process_index) {
+      Node node(state, state.getCurrentPlayerNum(), {-1, -1}, process_index + 1);
+      node.setPlayoutLimit(kBenchmarkPlayoutLimit);
+      return node;
+    }, state.getCurrentPlayerNum());
+    const double seconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count()};
+
+    int play_cnt{};
+    for (const auto& statistics : search.getStatistics()) {
+      play_cnt += statistics.play_cnt;
+    }
+    const double rate{play_cnt / seconds};
+    if (num_processes == 1) {
+      base_rate = rate;
+    }
+
+    os << std::setw(9) << num_processes
+       << std::setw(10) << play_cnt
+       << std::setw(8) << search.getFailedProcessCount()
+       << std::setw(9) << std::fixed << std::setprecision(3) << seconds
+       << std::setw(12) << std::setprecision(0) << rate
+       << std::setw(9) << std::setprecision(2) << rate / base_rate
+       << std::setw(6) << OthelloState::coord2Str(search.getBestAction()) << std::endl;
+  }
+}
+
+/* 同じプレイアウト回数で、RAVEを使う探索と使わない探索を先後入れ替えながら対戦させる。 */
+void benchmarkRave(std::ostream& os) {
+  using Node = MonteCarloTreeNode<OthelloState, coord, 2>;
+  constexpr int kGames{20};
+  constexpr int kPlayoutsPerMove{1000};
+
+  os << "games  playouts/move  rave_equivalence  rave_score" << std::endl;
+  for (const double rave_equivalence : {30.0, 300.0, 1000.0}) {
+    double rave_score{};
+    for (int game = 0; game < kGames; game++) {
+      const int rave_player{game % 2};
+      OthelloState state{};
+      while (!state.isFinished()) {
+        Node node(state, state.getCurrentPlayerNum(), {-1, -1}, game * 1000 + state.countDisksOf(0) + state.countDisksOf(1));
+        node.setPlayoutLimit(kPlayoutsPerMove);
+        if (state.getCurrentPlayerNum() == rave_player) {
+          node.setRaveEquivalence(rave_equivalence);
+        }
+        state = state.next(node.search());
+      }
+      rave_score += (state.getScore(rave_player) == 1) ? 1.0 : (state.getScore(1 - rave_player) == 1) ? 0.0 : 0.5;
+    }
+
+    os << std::setw(5) << kGames
+       << std::setw(15) << kPlayoutsPerMove
+       << std::setw(18) << std::fixed << std::setprecision(0) << rave_equivalence
+       << std::setw(12) << std::setprecision(3) << rave_score / kGames << std::endl;
+  }
+}
+
+/* 固定した乱数で進めた、序盤から終盤までのposition_cnt局面。 */
+std::vector<OthelloState> randomPositions(const int position_cnt) {
+  XorShift64 random_engine{2};
+  std::vector<OthelloState> result{};
+  while ((int)result.size() < position_cnt) {
+    OthelloState state{};
+    const int plies{(int)(random_engine() % 56)};
+    for (int i = 0; i < plies && !state.isFinished(); i++) {
+      const std::vector<coord> actions{state.legalActions()};
+      state = state.next(actions.at(random_engine() % actions.size()));
+    }
+    if (!state.isFinished()) {
+      result.push_back(state);
+    }
+  }
+  return result;
+}
+
+/* パターン評価器の評価速度を線形評価器や終局までのプレイアウトと比べ、 */
+/* 同じ持ち時間で、プレイアウトを打ち切ってパターン評価器で評価する探索と、終局まで打つ探索を先後入れ替えながら対戦させる。 */
+void benchmarkPattern(std::ostream& os) {
+  using Node = MonteCarloTreeNode<OthelloState, coord, 2>;
+  constexpr int kPositions{2000};
+  constexpr int kRepeats{20};
+  constexpr int kGames{20};
+  constexpr int kMoveMilliseconds{20};
+
+  auto evaluator{std::make_shared<OthelloPatternEvaluator>()};
+  if (!evaluator->load(kPatternPath)) {
+    os << "重みファイルがないので、重みが0の評価器で計測します: " << kPatternPath << std::endl;
+  }
+  const OthelloLinearEvaluator linear_evaluator{};
+  const std::vector<OthelloState> positions{randomPositions(kPositions)};
+
+  const auto measure{[&positions](const auto& evaluate) {
+    double sum{};
+    const auto start_time{std::chrono::steady_clock::now()};
+    for (int repeat = 0; repeat < kRepeats; repeat++) {
+      for (const OthelloState& state : positions) {
+        sum += evaluate(state);
+      }
+    }
+    const double seconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count()};
+    return std::make_pair(positions.size() * kRepeats / seconds, sum);
+  }};
+  XorShift64 random_engine{3};
+  const auto playout{[&random_engine](OthelloState state, const int depth) {
+    for (int i = 0; (depth <= 0 || i < depth) && !state.isFinished(); i++) {
+      const std::vector<coord> actions{state.legalActions()};
+      state.apply(actions.at(random_engine() % actions.size()));
+    }
+    return state;
+  }};
+
+  os << "method             evaluations/s" << std::endl;
+  const auto print_rate{[&os](const char* method, const std::pair<double, double>& result) {
+    os << std::left << std::setw(19) << method << std::right << std::setw(13) << std::fixed << std::setprecision(0) << result.first << std::endl;
+  }};
+  print_rate("pattern", measure([&evaluator](const OthelloState& state) { return evaluator->evaluate(state); }));
+  print_rate("linear", measure([&linear_evaluator](const OthelloState& state) { return linear_evaluator.evaluate(state); }));
+  print_rate("playout", measure([&playout](const OthelloState& state) {
+    return (double)playout(state, 0).getScore(OthelloState::kBlackTurn);
+  }));
+  print_rate("playout8+pattern", measure([&playout, &evaluator](const OthelloState& state) {
+    return evaluator->evaluate(playout(state, 8));
+  }));
+
+  os << std::endl << "games  ms/move  depth  truncated_score  truncated_playouts/move  full_playouts/move" << std::endl;
+  for (const int depth : {4, 8, 16}) {
+    double truncated_score{};
+    long truncated_play_cnt{};
+    long full_play_cnt{};
+    int truncated_move_cnt{};
+    int full_move_cnt{};
+    for (int game = 0; game < kGames; game++) {
+      const int truncated_player{game % 2};
+      OthelloState state{};
+      while (!state.isFinished()) {
+        Node node(state, state.getCurrentPlayerNum(), {-1, -1}, game * 1000 + state.countDisksOf(0) + state.countDisksOf(1));
+        node.setPlayoutLimit(std::numeric_limits<int>::max());
+        const bool is_truncated{state.getCurrentPlayerNum() == truncated_player};
+        if (is_truncated) {
+          node.setTruncatedPlayout(depth, OthelloPatternEvaluator::asPlayoutEvaluator(evaluator));
+        }
+        const SearchStopToken stop_token{SearchStopToken().withDeadline(
+            SearchStopToken::Clock::now() + std::chrono::milliseconds(kMoveMilliseconds))};
+        state = state.next(node.search(stop_token));
+        (is_truncated ? truncated_play_cnt : full_play_cnt) += node.getPlayCount();
+        (is_truncated ? truncated_move_cnt : full_move_cnt)++;
+      }
+      truncated_score += (state.getScore(truncated_player) == 1) ? 1.0 : (state.getScore(1 - truncated_player) == 1) ? 0.0 : 0.5;
+    }
+
+    os << std::setw(5) << kGames
+       << std::setw(9) << kMoveMilliseconds
+       << std::setw(7) << depth
+       << std::setw(17) << std::fixed << std::setprecision(3) << truncated_score / kGames
+       << std::setw(25) << std::setprecision(0) << (double)truncated_play_cnt / std::max(truncated_move_cnt, 1)
+       << std::setw(20) << (double)full_play_cnt / std::max(full_move_cnt, 1) << std::endl;
+  }
+}
+
+/* 行動を座標(coord)で表す探索と、マスの添字(square_index)で表す探索で、節点の大きさと同じプレイアウト回数での探索時間を比べる。 */
+template <typename GameAction>
+void benchmarkActionType(std::ostream& os, const char* name, const GameAction& no_action) {
+  using Node = MonteCarloTreeNode<OthelloState, GameAction, 2>;
+  const OthelloState state{benchmarkPosition()};
+  const std::vector<OthelloState> positions{randomPositions(2000)};
+
+  /* 合法手の列挙と着手だけの速さ。 */
+  const auto start_time{std::chrono::steady_clock::now()};
+  long move_cnt{};
+  for (int repeat = 0; repeat < 50; repeat++) {
+    for (const OthelloState& position : positions) {
+      for (const GameAction& action : legalActionsOf<GameAction>(position)) {
+        move_cnt += position.next(action).getCurrentPlayerNum();
+      }
+    }
+  }
+  const double move_seconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count()};
+
+  Node node(state, state.getCurrentPlayerNum(), no_action, 1);
+  node.setPlayoutLimit(kBenchmarkPlayoutLimit);
+  const auto search_start_time{std::chrono::steady_clock::now()};
+  const GameAction best_action{node.search()};
+  const double search_seconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - search_start_time).count()};
+
+  os << std::left << std::setw(13) << name << std::right
+     << std::setw(10) << sizeof(GameAction)
+     << std::setw(11) << sizeof(Node)
+     << std::setw(16) << std::fixed << std::setprecision(0) << move_cnt / move_seconds
+     << std::setw(12) << node.getPlayCount() / search_seconds
+     << std::setw(7) << node.getNodeCount()
+     << std::setw(6) << OthelloState::coord2Str(OthelloState::square2Coord(OthelloState::actionIndex(best_action))) << std::endl;
+}
+
+void benchmarkAction(std::ostream& os) {
+  os << "action_type  action_B  node_B  legal+next/s  playouts/s  nodes  best" << std::endl;
+  benchmarkActionType<coord>(os, "coord", coord(-1, -1));
+  benchmarkActionType<square_index>(os, "square_index", kPassSquare);
+}
+
+/* 多数の局面を同時に探索するとき、要求ごとにスレッドを立ててsearch()を呼ぶ場合と、MonteCarloSearchSchedulerに任せる場合を比べる。 */
+/* 締め切りがすべて同じ場合と、kMinDeadlineからkMaxDeadlineまでばらける場合について、 */
+/* 処理量、締め切りに遅れた要求の数と最大の遅れ、要求ごとのプレイアウト回数の最小値を出力する。 */
+void benchmarkScheduler(std::ostream& os) {
+  using Node = MonteCarloTreeNode<OthelloState, coord, 2>;
+  using Clock = std::chrono::steady_clock;
+  constexpr int kRequests{64};
+  constexpr int kMinDeadlineMilliseconds{100};
+  constexpr int kMaxDeadlineMilliseconds{400};
+
+  const std::vector<OthelloState> positions{randomPositions(kRequests)};
+  const int num_threads{std::max((int)std::thread::hardware_concurrency(), 1)};
+
+  os << "threads  deadlines  method      playouts/s  late  max_late_ms  mean_latency_ms  min_playouts" << std::endl;
+  for (const bool is_staggered : {false, true}) {
+    const auto deadlineOf{[is_staggered](const Clock::time_point start_time, const int i) {
+      const int milliseconds{is_staggered ? kMinDeadlineMilliseconds + (kMaxDeadlineMilliseconds - kMinDeadlineMilliseconds) * i / (kRequests - 1)
+                                          : kMaxDeadlineMilliseconds};
+      return start_time + std::chrono::milliseconds(milliseconds);
+    }};
+
+    for (const bool is_scheduled : {false, true}) {
+      std::vector<Node> nodes{};
+      for (int i = 0; i < kRequests; i++) {
+        nodes.emplace_back(positions.at(i), positions.at(i).getCurrentPlayerNum(), coord(-1, -1), i + 1);
+        nodes.back().setPlayoutLimit(std::numeric_limits<int>::max());
+      }
+      std::vector<Clock::time_point> deadlines(kRequests);
+      std::vector<Clock::time_point> completion_times(kRequests);
+      SearchSchedulerStatistics statistics{};
+
+      const Clock::time_point start_time{Clock::now()};
+      if (is_scheduled) {
+        MonteCarloSearchScheduler<coord> scheduler(num_threads);
+        std::vector<std::future<coord>> results{};
+        for (int i = 0; i < kRequests; i++) {
+          deadlines.at(i) = deadlineOf(start_time, i);
+          results.push_back(scheduler.submit(nodes.at(i), deadlines.at(i)));
+        }
+        for (std::future<coord>& result : results) {
+          result.wait();
+        }
+        statistics = scheduler.getStatistics();
+      } else {
+        std::vector<std::thread> threads{};
+        for (int i = 0; i < kRequests; i++) {
+          deadlines.at(i) = deadlineOf(start_time, i);
+          threads.emplace_back([&, i]() {
+            nodes.at(i).search(SearchStopToken().withDeadline(deadlines.at(i)));
+            completion_times.at(i) = Clock::now();
+          });
+        }
+        for (std::thread& thread : threads) {
+          thread.join();
+        }
+      }
+      const double seconds{std::chrono::duration<double>(Clock::now() - start_time).count()};
+
+      long play_cnt{};
+      int min_play_cnt{std::numeric_limits<int>::max()};
+      for (const Node& node : nodes) {
+        play_cnt += node.getPlayCount();
+        min_play_cnt = std::min(min_play_cnt, node.getPlayCount());
+      }
+
+      /* スケジューラでは、答えを返した時刻をスケジューラ自身が数えた集計を使う。 */
+      int late_cnt{statistics.late_cnt};
+      double max_late_milliseconds{statistics.max_lateness_seconds * 1000.0};
+      double sum_latency_milliseconds{statistics.mean_latency_seconds * 1000.0 * kRequests};
+      if (!is_scheduled) {
+        for (int i = 0; i < kRequests; i++) {
+          const double late_milliseconds{std::chrono::duration<double, std::milli>(completion_times.at(i) - deadlines.at(i)).count()};
+          if (late_milliseconds > 0.0) {
+            late_cnt++;
+          }
+          max_late_milliseconds = std::max(max_late_milliseconds, late_milliseconds);
+          sum_latency_milliseconds += std::chrono::duration<double, std::milli>(completion_times.at(i) - start_time).count();
+        }
+      }
+
+      os << std::setw(7) << num_threads
+         << std::setw(11) << (is_staggered ? "staggered" : "same")
+         << "  " << std::left << std::setw(10) << (is_scheduled ? "scheduler" : "threads") << std::right
+         << std::setw(12) << std::fixed << std::setprecision(0) << play_cnt / seconds
+         << std::setw(6) << late_cnt
+         << std::setw(13) << std::setprecision(1) << max_late_milliseconds
+         << std::setw(17) << sum_latency_milliseconds / kRequests
+         << std::setw(14) << min_play_cnt << std::endl;
+    }
+  }
+}
+
+/* MonteCarloTreeNodeとPrimitiveMonteCarloRootの探索をSearchProfilerで数え、探索1回あたりと段階1回あたりの値を出力する。 */
+/* 段階ごとの計測を毎回行う場合と、kProfileSampleInterval回に1回行う場合の速さを、数えない場合と比べる。 */
+void benchmarkProfile(std::ostream& os) {
+  constexpr int kProfileSampleInterval{16};
+  if (!kIsSearchProfilingEnabled) {
+    os << "MONTE_CARLO_PROFILEを定義してビルドしてください(make profileでout/profile/mainができます)。" << std::endl;
+    return;
+  }
+
+  SearchProfiler profiler{};
+  if (!profiler.isAvailable()) {
+    os << "perf_event_openでカウンタを開けませんでした。" << std::endl;
+    return;
+  }
+
+  const OthelloState state{benchmarkPosition()};
+  const auto searchTree{[&state]() {
+    MonteCarloTreeNode<OthelloState, coord, 2> node(state, state.getCurrentPlayerNum(), {-1, -1}, 1);
+    node.setPlayoutLimit(kBenchmarkPlayoutLimit);
+    const auto start_time{std::chrono::steady_clock::now()};
+    node.search();
+    return kBenchmarkPlayoutLimit / std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+  }};
+
+  const double base_playouts_per_second{searchTree()};
+  os << "MonteCarloTreeNode, " << kBenchmarkPlayoutLimit << " playouts" << std::endl;
+  for (const int interval : {1, kProfileSampleInterval}) {
+    profiler.reset();
+    profiler.setSampleInterval(interval);
+    profiler.attach();
+    const double playouts_per_second{searchTree()};
+    profiler.detach();
+    os << "sample_interval " << interval << ": " << std::fixed << std::setprecision(0) << playouts_per_second << " playouts/s ("
+       << std::setprecision(0) << base_playouts_per_second << " without profiler)" << std::endl;
+    profiler.getProfile().print(os);
+  }
+
+  OthelloStateEstimator estimator{};
+  PrimitiveMonteCarloRoot<OthelloState, OthelloObservation, OthelloStateEstimator, coord, 2> root(
+      state.getObservation(), estimator, state.getCurrentPlayerNum());
+  profiler.reset();
+  profiler.setSampleInterval(kProfileSampleInterval);
+  profiler.attach();
+  root.search();
+  profiler.detach();
+  os << "PrimitiveMonteCarloRoot, sample_interval " << kProfileSampleInterval << std::endl;
+  profiler.getProfile().print(os);
+}
+
+/* スレッド数とワーカの置き方を変えて、MonteCarloTreePondererで一定時間探索したときの処理量を比べる。 */
+/* 速さの比は、同じ置き方の1スレッドとの比。 */
+void benchmarkScaling(std::ostream& os) {
+  constexpr std::chrono::milliseconds kPonderDuration{1000};
+  const OthelloState state{benchmarkPosition()};
+  const int max_threads{std::max((int)std::thread::hardware_concurrency(), 1)};
+  std::vector<int> thread_counts{};
+  for (int num_threads = 1; num_threads < max_threads; num_threads *= 2) {
+    thread_counts.push_back(num_threads);
+  }
+  thread_counts.push_back(max_threads);
+
+  const std::vector<std::pair<const char*, WorkerPoolSettings>> placements{
+      {"default", WorkerPoolSettings()},
+      {"pinned+arena", WorkerPoolSettings{true, true, false}},
+      {"pinned+arena+thp", WorkerPoolSettings{true, true, true}}};
+
+  os << "placement         threads  playouts  seconds  playouts/s  per_thread  speedup" << std::endl;
+  for (const auto& [name, settings] : placements) {
+    double base_rate{};
+    for (const int num_threads : thread_counts) {
+      MonteCarloTreePonderer<OthelloState, coord, 2> ponderer(num_threads, settings);
+      const auto start_time{std::chrono::steady_clock::now()};
+      ponderer.start(MonteCarloTreeNode<OthelloState, coord, 2>(state, state.getCurrentPlayerNum(), {-1, -1}, 1));
+      std::this_thread::sleep_for(kPonderDuration);
+      const MonteCarloTreeNode<OthelloState, coord, 2> node{ponderer.stop()};
+      const double seconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count()};
+
+      const double rate{node.getPlayCount() / seconds};
+      if (num_threads == 1) {
+        base_rate = rate;
+      }
+      os << std::left << std::setw(18) << name << std::right
+         << std::setw(7) << num_threads
+         << std::setw(10) << node.getPlayCount()
+         << std::setw(9) << std::fixed << std::setprecision(3) << seconds
+         << std::setw(12) << std::setprecision(0) << rate
+         << std::setw(12) << rate / num_threads
+         << std::setw(9) << std::setprecision(2) << rate / base_rate << std::endl;
+    }
+  }
+}
+
+} // namespace
+
+bool runBenchmark(const std::string& name, std::ostream& os) {
+  if (name == "leaf") {
+    benchmarkLeafParallel(os);
+    return true;
+  }
+  if (name == "process") {
+    benchmarkProcessParallel(os);
+    return true;
+  }
+  if (name == "rave") {
+    benchmarkRave(os);
+    return true;
+  }
+  if (name == "scheduler") {
+    benchmarkScheduler(os);
+    return true;
+  }
+  if (name == "action") {
+    benchmarkAction(os);
+    return true;
+  }
+  if (name == "pattern") {
+    benchmarkPattern(os);
+    return true;
+  }
+  if (name == "profile") {
+    benchmarkProfile(os);
+    return true;
+  }
+  if (name == "scaling") {
+    benchmarkScaling(os);
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,10 @@
+#ifndef OTHELLO_BENCHMARK_HPP_
+#define OTHELLO_BENCHMARK_HPP_
+
+#include <iostream>
+#include <string>
+
+/* 名前nameのベンチマークを実行して結果をosへ出力する。該当するものがなければfalseを返す。 */
+bool runBenchmark(const std::string& name, std::ostream& os);
+
+#endif // OTHELLO_BENCHMARK_HPP_
@@ -0,0 +1,183 @@
+#include "othello_book.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../monte_carlo_tree_node.hpp"
+
+namespace {
+
+bool entryLess(const OthelloBookEntry& a, const OthelloBookEntry& b) {
+  return std::tie(a.key, a.black_board, a.white_board, a.cur_turn) <
+         std::tie(b.key, b.black_board, b.white_board, b.cur_turn);
+}
+
+/* 初期局面からmax_plies手目までに現れる、終局していない局面を正規形で重複なく列挙する。 */
+std::vector<OthelloState> enumeratePositions(const int max_plies) {
+  std::vector<OthelloState> result{};
+  std::vector<OthelloState> frontier{OthelloState().canonical()};
+  for (int ply = 0; ply < max_plies && !frontier.empty(); ply++) {
+    std::vector<OthelloState> next_frontier{};
+    for (const OthelloState& state : frontier) {
+      if (state.isFinished()) { continue; }
+      result.push_back(state);
+      for (const coord& action : state.legalActions()) {
+        next_frontier.push_back(state.next(action).canonical());
+      }
+    }
+
+    /* 同じ局面に別の手順で到達することがあるので、重複を除く。 */
+    const auto key{[](const OthelloState& s) { return std::make_tuple(s.getBlackBoard(), s.getWhiteBoard(), s.getCurrentPlayerNum()); }};
+    std::sort(next_frontier.begin(), next_frontier.end(),
+        [&key](const OthelloState& a, const OthelloState& b) { return key(a) < key(b); });
+    next_frontier.erase(std::unique(next_frontier.begin(), next_frontier.end(),
+        [&key](const OthelloState& a, const OthelloState& b) { return key(a) == key(b); }), next_frontier.end());
+    frontier = std::move(next_frontier);
+  }
+  return result;
+}
+
+} // namespace
+
+bool OthelloBook::open(const std::string& path) {
+  this->close();
+
+  const int fd{::open(path.c_str(), O_RDONLY)};
+  if (fd < 0) { return false; }
+
+  struct stat st{};
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(OthelloBookHeader)) {
+    ::close(fd);
+    return false;
+  }
+
+  void* mapped{mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)};
+  ::close(fd); // mmapした領域はfdを閉じても有効。
+  if (mapped == MAP_FAILED) { return false; }
+  this->mapped_ = mapped;
+  this->mapped_size_ = st.st_size;
+
+  const OthelloBookHeader& h{this->header()};
+  /* 掛け算があふれないように、入るエントリ数と比べる。 */
+  if (h.magic != kMagic || h.version != kVersion || h.entry_size != sizeof(OthelloBookEntry) ||
+      h.entry_cnt > (this->mapped_size_ - sizeof(OthelloBookHeader)) / sizeof(OthelloBookEntry)) {
+    this->close();
+    return false;
+  }
+  return true;
+}
+
+void OthelloBook::close() {
+  if (this->mapped_ != nullptr) {
+    munmap(this->mapped_, this->mapped_size_);
+  }
+  this->mapped_ = nullptr;
+  this->mapped_size_ = 0;
+}
+
+bool OthelloBook::lookup(const OthelloState& state, coord& action) const {
+  if (!this->isOpen()) { return false; }
+
+  const int symmetry{state.canonicalSymmetry()};
+  const OthelloState canonical_state{state.transform(symmetry)};
+
+  OthelloBookEntry target{};
+  target.key = OthelloBook::hashKey(canonical_state.getBlackBoard(), canonical_state.getWhiteBoard(), canonical_state.getCurrentPlayerNum());
+  target.black_board = canonical_state.getBlackBoard();
+  target.white_board = canonical_state.getWhiteBoard();
+  target.cur_turn = canonical_state.getCurrentPlayerNum();
+
+  const OthelloBookEntry* begin{this->entries()};
+  const OthelloBookEntry* end{begin + this->size()};
+  const OthelloBookEntry* found{std::lower_bound(begin, end, target, entryLess)};
+  if (found == end || entryLess(target, *found)) { return false; }
+
+  /* 正規形での最善手を、元の局面の向きに戻す。 */
+  const coord canonical_action(found->best_square % 8, found->best_square / 8);
+  action = OthelloState::transformCoord(canonical_action, OthelloState::inverseSymmetry(symmetry));
+  return true;
+}
+
+bool OthelloBook::build(const std::string& path, const int max_plies, const int playout_limit, const int num_threads) {
+  const std::vector<OthelloState> positions{enumeratePositions(max_plies)};
+  std::vector<OthelloBookEntry> entries(positions.size());
+  std::vector<char> is_searched(positions.size()); // 根でプレイアウトしたか。
+
+  /* 局面ごとに独立な探索なので、空いたスレッドが次の局面を取っていく。 */
+  std::atomic<std::size_t> next_index{0};
+  std::random_device seed_gen;
+  std::vector<std::thread> workers{};
+  for (int t = 0; t < std::max(num_threads, 1); t++) {
+    workers.emplace_back([&, seed = seed_gen()]() {
+      for (std::size_t i = next_index++; i < positions.size(); i = next_index++) {
+        const OthelloState& state{positions.at(i)};
+        MonteCarloTreeNode<OthelloState, coord, 2> node(state, state.getCurrentPlayerNum(), {-1, -1}, seed + i);
+        node.setPlayoutLimit(playout_limit);
+        const coord action{node.search()};
+
+        /* 子が1つしかなければ探索せずに返るので、石差の見積もりがない。定石に入れず、対局時の探索に任せる。 */
+        if (node.getPlayCount() <= 0) { continue; }
+        is_searched.at(i) = true;
+
+        OthelloBookEntry& entry{entries.at(i)};
+        entry.key = OthelloBook::hashKey(state.getBlackBoard(), state.getWhiteBoard(), state.getCurrentPlayerNum());
+        entry.black_board = state.getBlackBoard();
+        entry.white_board = state.getWhiteBoard();
+        entry.cur_turn = state.getCurrentPlayerNum();
+        entry.best_square = action.first + 8 * action.second;
+        for (const auto& child : node.getChildren()) {
+          if (child.getLastAction() == action) {
+            entry.play_cnt = child.getPlayCount();
+          }
+        }
+        entry.mean_score = node.getEstimatedMinMaxScore(state.getCurrentPlayerNum());
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+
+  std::size_t entry_cnt{};
+  for (std::size_t i = 0; i < entries.size(); i++) {
+    if (is_searched.at(i)) {
+      entries.at(entry_cnt++) = entries.at(i);
+    }
+  }
+  entries.resize(entry_cnt);
+  std::sort(entries.begin(), entries.end(), entryLess);
+
+  OthelloBookHeader header{};
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.entry_size = sizeof(OthelloBookEntry);
+  header.entry_cnt = entries.size();
+  header.max_plies = max_plies;
+  header.playout_limit = playout_limit;
+
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  ofs.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(OthelloBookEntry));
+  return ofs.good();
+}
+
+uint64_t OthelloBook::hashKey(const bitboard black_board, const bitboard white_board, const int cur_turn) {
+  /* splitmix64の撹拌関数で、盤面の偏りを散らす。 */
+  const auto mix{[](uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+    return x ^ (x >> 31);
+  }};
+  return mix(black_board ^ mix(white_board ^ mix(cur_turn)));
+}
@@ -0,0 +1,76 @@
+#ifndef OTHELLO_BOOK_HPP_
+#define OTHELLO_BOOK_HPP_
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "othello_state.hpp"
+#include "othello_types.hpp"
+
+/* 定石ファイルの形式。 */
+/* [OthelloBookHeader][OthelloBookEntry × entry_cnt] */
+/* 局面は対称変換で正規形に直してから登録し、エントリは(key, 黒, 白, 手番)の昇順に並ぶ。 */
+
+struct OthelloBookHeader {
+  std::array<char, 8> magic; // "OTHBOOK"
+  uint32_t version;
+  uint32_t entry_size;
+  uint64_t entry_cnt;
+  uint32_t max_plies;        // 何手目までの局面を登録したか。
+  uint32_t playout_limit;    // 1局面あたりのプレイアウト回数。
+};
+
+struct OthelloBookEntry {
+  uint64_t key;              // 正規形の局面のハッシュ値。
+  bitboard black_board;
+  bitboard white_board;
+  uint8_t cur_turn;
+  uint8_t best_square;       // 正規形での最善手。A1, B1, ..., H8 の順の添字。
+  uint16_t reserved;
+  int32_t play_cnt;          // 最善手の探索回数。
+  double mean_score;         // 最善手の平均得点。
+};
+
+/* mmapした定石ファイルを引く。 */
+class OthelloBook {
+ public:
+  static constexpr std::array<char, 8> kMagic{'O', 'T', 'H', 'B', 'O', 'O', 'K', '\0'};
+  static constexpr uint32_t kVersion{1};
+
+  OthelloBook() = default;
+
+  OthelloBook(const OthelloBook&) = delete;
+  OthelloBook& operator=(const OthelloBook&) = delete;
+
+  ~OthelloBook() { this->close(); }
+
+  /* 定石ファイルをmmapする。形式が合わなければfalseを返す。 */
+  bool open(const std::string& path);
+
+  void close();
+
+  bool isOpen() const { return this->mapped_ != nullptr; }
+
+  std::size_t size() const { return this->isOpen() ? this->header().entry_cnt : 0; }
+
+  /* 局面が定石にあれば、その局面での最善手をactionに入れてtrueを返す。 */
+  bool lookup(const OthelloState& state, coord& action) const;
+
+  /* max_plies手目までに現れる局面をすべて列挙し、num_threads並列でそれぞれplayout_limit回探索して定石ファイルを作る。 */
+  static bool build(const std::string& path, const int max_plies, const int playout_limit, const int num_threads);
+
+  static uint64_t hashKey(const bitboard black_board, const bitboard white_board, const int cur_turn);
+
+ private:
+  void* mapped_{nullptr};
+  std::size_t mapped_size_{};
+
+  const OthelloBookHeader& header() const { return *static_cast<const OthelloBookHeader*>(this->mapped_); }
+
+  const OthelloBookEntry* entries() const {
+    return reinterpret_cast<const OthelloBookEntry*>(static_cast<const char*>(this->mapped_) + sizeof(OthelloBookHeader));
+  }
+};
+
+#endif // OTHELLO_BOOK_HPP_
@@ -0,0 +1,200 @@
+#include "othello_engine.hpp"
+
+#include <iomanip>
+#include <limits>
+
+void OthelloEngine::run() {
+  std::string line{};
+  while (std::getline(this->is_, line)) {
+    if (!this->execute(line)) { break; }
+  }
+  this->stop();
+}
+
+bool OthelloEngine::execute(const std::string& line) {
+  std::istringstream args(line);
+  std::string command{};
+  if (!(args >> command)) { return true; }
+
+  bool is_succeeded{true};
+  if (command == "position") {
+    is_succeeded = this->position(args);
+  } else if (command == "play") {
+    std::string move{};
+    args >> move;
+    is_succeeded = this->play(move);
+  } else if (command == "go") {
+    is_succeeded = this->go(args);
+  } else if (command == "stop") {
+    this->stop();
+  } else if (command == "stats") {
+    this->stats();
+  } else if (command == "isready") {
+    this->print("readyok");
+  } else if (command == "quit") {
+    return false;
+  } else {
+    this->print("error unknown command: " + command);
+    return true;
+  }
+
+  if (!is_succeeded) {
+    this->print("error invalid arguments: " + line);
+  }
+  return true;
+}
+
+bool OthelloEngine::position(std::istringstream& args) {
+  this->stop();
+
+  std::string kind{};
+  args >> kind;
+  OthelloState state{};
+  if (kind == "board") {
+    std::string board{};
+    std::string turn{};
+    args >> board >> turn;
+    if (board.size() != (std::size_t)OthelloState::kNumberOfSquares || (turn != "black" && turn != "white")) { return false; }
+
+    bitboard black_board{};
+    bitboard white_board{};
+    for (int i = 0; i < OthelloState::kNumberOfSquares; i++) {
+      const bitboard square{OthelloState::coord2Bit(coord(i % 8, i / 8))};
+      if (board.at(i) == 'X') {
+        black_board |= square;
+      } else if (board.at(i) == 'O') {
+        white_board |= square;
+      } else if (board.at(i) != '-') {
+        return false;
+      }
+    }
+    state = OthelloState(black_board, white_board, (turn == "black") ? OthelloState::kBlackTurn : OthelloState::kWhiteTurn);
+  } else if (kind != "startpos") {
+    return false;
+  }
+
+  std::string word{};
+  if (args >> word) {
+    if (word != "moves") { return false; }
+    while (args >> word) {
+      const coord action{OthelloState::str2Coord(word)};
+      if (action == coord(-1, -1) || state.isFinished() || !state.isLegal(action)) { return false; }
+      state = state.next(action);
+    }
+  }
+
+  /* 同じ局面なら、木をそのまま使い続ける。 */
+  if (!(state == this->state_)) {
+    this->state_ = state;
+    this->resetTree();
+  }
+  return true;
+}
+
+bool OthelloEngine::play(const std::string& move) {
+  const coord action{OthelloState::str2Coord(move)};
+  if (action == coord(-1, -1) || this->state_.isFinished() || !this->state_.isLegal(action)) { return false; }
+
+  this->stop();
+  this->state_ = this->state_.next(action);
+  this->tree_ = this->tree_.extractChild(action);
+  return true;
+}
+
+bool OthelloEngine::go(std::istringstream& args) {
+  this->stop();
+
+  int playout_limit{kDefaultPlayoutLimit};
+  SearchStopToken::Clock::time_point deadline{SearchStopToken::Clock::time_point::max()};
+  bool is_time_limited{false};
+  std::string word{};
+  while (args >> word) {
+    int value{};
+    if (word == "infinite") {
+      playout_limit = std::numeric_limits<int>::max();
+    } else if (word == "playouts" && args >> value && value > 0) {
+      playout_limit = value;
+    } else if (word == "time" && args >> value && value >= 0) {
+      deadline = SearchStopToken::Clock::now() + std::chrono::milliseconds(value);
+      is_time_limited = true;
+    } else {
+      return false;
+    }
+  }
+  /* 時間だけを指定したなら、回数では止めない。 */
+  if (is_time_limited && playout_limit == kDefaultPlayoutLimit) {
+    playout_limit = std::numeric_limits<int>::max();
+  }
+
+  if (this->state_.isFinished()) {
+    this->print("bestmove none");
+    return true;
+  }
+
+  /* 定石にある局面なら探索しない。 */
+  coord book_action{};
+  if (this->book_.lookup(this->state_, book_action)) {
+    this->print("bestmove " + OthelloState::coord2Str(book_action));
+    return true;
+  }
+
+  this->stop_source_ = SearchStopSource();
+  this->tree_.setPlayoutLimit(playout_limit);
+  /* 残りの回数や時間で最善手が入れ替わりえなくなったら、早めに答える。infiniteでは残りが尽きないので打ち切られない。 */
+  this->tree_.setEarlyStop(EarlyStopRule::kBudget);
+  const SearchStopToken stop_token{this->stop_source_.token().withDeadline(deadline)};
+  this->is_searching_.store(true);
+  this->search_thread_ = std::thread([this, stop_token]() {
+    const coord action{this->tree_.search(stop_token, [this](const SearchProgress<coord>& progress) {
+      {
+        std::lock_guard<std::mutex> lock(this->progress_mutex_);
+        this->last_progress_ = progress;
+        this->last_node_cnt_ = this->tree_.getNodeCount();
+      }
+      std::ostringstream info{};
+      info << "info playouts " << progress.whole_play_cnt << " best " << OthelloState::coord2Str(progress.best_action)
+           << " visits " << progress.best_play_cnt << " score " << std::fixed << std::setprecision(3) << progress.mean_score
+           << " pps " << std::setprecision(0) << progress.playouts_per_second;
+      this->print(info.str());
+    }, kProgressInterval)};
+    this->is_searching_.store(false);
+    if (this->tree_.getSavedPlayoutCount() > 0.0) {
+      std::ostringstream info{};
+      info << "info settled saved_playouts " << std::fixed << std::setprecision(0) << this->tree_.getSavedPlayoutCount()
+           << " saved_seconds " << std::setprecision(3) << this->tree_.getSavedSeconds();
+      this->print(info.str());
+    }
+    this->print("bestmove " + OthelloState::coord2Str(action));
+  });
+  return true;
+}
+
+void OthelloEngine::stats() {
+  std::ostringstream line{};
+  line << "stats searching " << (this->isSearching() ? "yes" : "no");
+  if (this->isSearching()) {
+    std::lock_guard<std::mutex> lock(this->progress_mutex_);
+    line << " nodes " << this->last_node_cnt_
+         << " playouts " << this->last_progress_.whole_play_cnt;
+  } else {
+    line << " nodes " << this->tree_.getNodeCount()
+         << " memory " << this->tree_.getMemoryUsage()
+         << " playouts " << this->tree_.getPlayCount();
+  }
+  this->print(line.str());
+}
+
+void OthelloEngine::stop() {
+  if (!this->search_thread_.joinable()) { return; }
+  this->stop_source_.requestStop();
+  this->search_thread_.join();
+}
+
+void OthelloEngine::resetTree() {
+  this->tree_ = Tree(this->state_, this->state_.getCurrentPlayerNum(), {-1, -1}, this->seed_gen_());
+}
+
+void OthelloEngine::print(const std::string& line) {
+  std::lock_guard<std::mutex> lock(this->output_mutex_);
+  this->os_ << line << std::endl;
+}
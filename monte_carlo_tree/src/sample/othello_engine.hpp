@@ -0,0 +1,87 @@
+#ifndef OTHELLO_ENGINE_HPP_
+#define OTHELLO_ENGINE_HPP_
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "../monte_carlo_tree_node.hpp"
+#include "../search_control.hpp"
+#include "othello_book.hpp"
+#include "othello_state.hpp"
+#include "othello_types.hpp"
+
+/* 標準入出力で行単位のコマンドを受け付ける、常駐型の思考エンジン。 */
+/* 探索木はコマンドをまたいで持ち越すので、play で進めた局面では前の探索の統計を引き継ぐ。 */
+/*
+ * position startpos [moves a1 b2 ...]       初期局面(から手を進めた局面)にする。
+ * position board <64文字> <black|white> [moves ...]
+ *                                            A1, B1, ..., H8 の順に X(黒) O(白) -(空) で盤面を指定する。
+ * play <着手>                                局面を1手進める。
+ * go [playouts N] [time ミリ秒] [infinite]   探索を始める。終わると bestmove <着手> を返す。
+ * stop                                       探索を止めて、その時点の bestmove を返す。
+ * stats                                      探索木の大きさと、直近の探索の状況を返す。
+ * isready                                    前のコマンドを処理し終えたら readyok を返す。
+ * quit                                       終了する。
+ */
+class OthelloEngine {
+ public:
+  using Tree = MonteCarloTreeNode<OthelloState, coord, 2>;
+
+  OthelloEngine(std::istream& is, std::ostream& os, const OthelloBook& book) : is_(is), os_(os), book_(book) {
+    this->resetTree();
+  }
+
+  OthelloEngine(const OthelloEngine&) = delete;
+  OthelloEngine& operator=(const OthelloEngine&) = delete;
+
+  ~OthelloEngine() { this->stop(); }
+
+  /* quitを受け取るか入力が終わるまで、コマンドを処理し続ける。 */
+  void run();
+
+  /* 1行分のコマンドを処理する。quitならfalseを返す。 */
+  bool execute(const std::string& line);
+
+ private:
+  static constexpr int kDefaultPlayoutLimit{10000}; // go に制限を指定しなかったときのプレイアウト回数。
+  static constexpr int kProgressInterval{1000};     // info を出力する間隔(探索回数)。
+
+  std::istream& is_;
+  std::ostream& os_;
+  std::mutex output_mutex_{};     // 探索スレッドと出力が混ざらないようにする。
+  const OthelloBook& book_;
+
+  OthelloState state_{};
+  Tree tree_{};
+  std::thread search_thread_{};
+  std::atomic<bool> is_searching_{false}; // 探索スレッドが終わっていてもjoinするまでsearch_thread_は残るので、別に持つ。
+  SearchStopSource stop_source_{};
+  std::random_device seed_gen_{};
+
+  /* 探索中にstatsで返すための、直近の探索の状況。探索スレッドが更新する。 */
+  std::mutex progress_mutex_{};
+  SearchProgress<coord> last_progress_{};
+  std::size_t last_node_cnt_{};
+
+  bool position(std::istringstream& args);
+  bool play(const std::string& move);
+  bool go(std::istringstream& args);
+  void stats();
+
+  /* 探索中なら止めて、探索スレッドの終了を待つ。 */
+  void stop();
+
+  bool isSearching() const { return this->is_searching_.load(); }
+
+  /* 現在の局面を根とする空の木を作り直す。 */
+  void resetTree();
+
+  void print(const std::string& line);
+};
+
+#endif // OTHELLO_ENGINE_HPP_
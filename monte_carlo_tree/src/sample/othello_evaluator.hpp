@@ -0,0 +1,79 @@
+#ifndef OTHELLO_EVALUATOR_HPP_
+#define OTHELLO_EVALUATOR_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "othello_state.hpp"
+#include "othello_types.hpp"
+
+/* MonteCarloTreeNode::searchBatched()用の、マスの重みと着手可能数による線形評価器。 */
+/* 同じ重みのマスをまとめたマスクを作っておき、局面ごとにマスクの数だけpopcountする。 */
+class OthelloLinearEvaluator {
+ public:
+  OthelloLinearEvaluator() {
+    for (int square = 0; square < 64; square++) {
+      const int weight{kSquareWeights.at(square)};
+      if (weight == 0) { continue; }
+
+      const bitboard bit{OthelloState::coord2Bit(coord(square % 8, square / 8))};
+      auto found{std::find_if(this->weighted_masks_.begin(), this->weighted_masks_.end(),
+          [weight](const std::pair<bitboard, int>& m) { return m.second == weight; })};
+      if (found == this->weighted_masks_.end()) {
+        this->weighted_masks_.emplace_back(bit, weight);
+      } else {
+        found->first |= bit;
+      }
+    }
+  }
+
+  /* 各局面の(黒の勝率, 白の勝率)の推定値を返す。 */
+  std::vector<std::array<double, 2>> evaluateBatch(const std::vector<OthelloState>& states) const {
+    std::vector<std::array<double, 2>> result(states.size());
+    for (std::size_t i = 0; i < states.size(); i++) {
+      const double black_win_rate{1.0 / (1.0 + std::exp(-this->evaluate(states.at(i)) / kScale))};
+      result.at(i).at(OthelloState::kBlackTurn) = black_win_rate;
+      result.at(i).at(OthelloState::kWhiteTurn) = 1.0 - black_win_rate;
+    }
+    return result;
+  }
+
+  /* 黒から見た評価値。 */
+  double evaluate(const OthelloState& state) const {
+    const bitboard black_board{state.getBlackBoard()};
+    const bitboard white_board{state.getWhiteBoard()};
+
+    int score{};
+    for (const auto& [mask, weight] : this->weighted_masks_) {
+      score += weight * (__builtin_popcountll(black_board & mask) - __builtin_popcountll(white_board & mask));
+    }
+
+    const int black_mobility{OthelloState(black_board, white_board, OthelloState::kBlackTurn).countLegalActions()};
+    const int white_mobility{OthelloState(black_board, white_board, OthelloState::kWhiteTurn).countLegalActions()};
+    score += kMobilityWeight * (black_mobility - white_mobility);
+
+    return score;
+  }
+
+ private:
+  static constexpr double kScale{40.0};     // 評価値を勝率に変換するときの尺度。
+  static constexpr int kMobilityWeight{5};  // 着手可能数1つあたりの重み。
+
+  /* マスの重み。A1, B1, ..., H8 の順。 */
+  static constexpr std::array<int, 64> kSquareWeights{
+    100, -40,  20,   5,   5,  20, -40, 100,
+    -40, -80,  -1,  -1,  -1,  -1, -80, -40,
+     20,  -1,   5,   1,   1,   5,  -1,  20,
+      5,  -1,   1,   0,   0,   1,  -1,   5,
+      5,  -1,   1,   0,   0,   1,  -1,   5,
+     20,  -1,   5,   1,   1,   5,  -1,  20,
+    -40, -80,  -1,  -1,  -1,  -1, -80, -40,
+    100, -40,  20,   5,   5,  20, -40, 100};
+
+  std::vector<std::pair<bitboard, int>> weighted_masks_{}; // 同じ重みのマスの集合と、その重み。
+};
+
+#endif // OTHELLO_EVALUATOR_HPP_
@@ -5,11 +5,15 @@
 
 #include "othello_types.hpp"
 
-struct OthelloObservation {
-  bitboard black_board_;
-  bitboard white_board_;
+/* GameActionは合法手の型。coordかsquare_index。 */
+template <typename bitboard_type, typename GameAction = coord>
+struct BasicOthelloObservation {
+  bitboard_type black_board_;
+  bitboard_type white_board_;
   int cur_turn_;
-  std::vector<coord> legal_actions_;
+  std::vector<GameAction> legal_actions_;
 };
 
+using OthelloObservation = BasicOthelloObservation<bitboard>;
+
 #endif // OTHELLO_OBSERVATION_HPP_
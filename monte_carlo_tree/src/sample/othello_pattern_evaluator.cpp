@@ -0,0 +1,185 @@
+#include "othello_pattern_evaluator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+#include <random>
+
+namespace {
+
+constexpr int kMaxPatternSize{10};
+
+/* 2進数の各桁を3進数の同じ桁に写す表。黒のbit列の値 + 2 × 白のbit列の値 で3進数の添字になる。 */
+constexpr std::array<uint16_t, 1 << kMaxPatternSize> makeTernaryTable() {
+  std::array<uint16_t, 1 << kMaxPatternSize> result{};
+  for (int bits = 0; bits < (1 << kMaxPatternSize); bits++) {
+    int value{};
+    for (int digit = kMaxPatternSize - 1; digit >= 0; digit--) {
+      value = value * 3 + ((bits >> digit) & 1);
+    }
+    result[bits] = value;
+  }
+  return result;
+}
+
+constexpr std::array<uint16_t, 1 << kMaxPatternSize> kTernary{makeTernaryTable()};
+
+/* A1から右下へ、x - y == offset のマス全体。 */
+constexpr bitboard diagonalMask(const int offset) {
+  bitboard result{};
+  for (int y = 0; y + offset < 8; y++) {
+    result |= othelloSquareBit<8>(y + offset, y);
+  }
+  return result;
+}
+
+constexpr std::array<bitboard, 5> kDiagonalMasks{diagonalMask(0), diagonalMask(1), diagonalMask(2), diagonalMask(3), diagonalMask(4)};
+
+/* y行目の8マス。最上位bitがA列。 */
+inline uint32_t row(const bitboard board, const int y) { return (board >> (56 - 8 * y)) & 0xff; }
+
+/* 列の重ならないマスの集合maskを、掛け算で最上位の1行に集める。最上位bitがA列。 */
+inline uint32_t gather(const bitboard board, const bitboard mask) { return ((board & mask) * 0x0101010101010101) >> 56; }
+
+/* 対称変換した盤boardから、パターンのマスのbit列を取り出す。kPatternSizesの順。 */
+inline std::array<uint32_t, OthelloPatternEvaluator::kNumberOfPatterns> patternBits(const bitboard board) {
+  const uint32_t row0{row(board, 0)};
+  const uint32_t row1{row(board, 1)};
+  const uint32_t row2{row(board, 2)};
+  return {
+    row1,
+    row2,
+    row(board, 3),
+    gather(board, kDiagonalMasks[0]),
+    gather(board, kDiagonalMasks[1]),
+    gather(board, kDiagonalMasks[2]),
+    gather(board, kDiagonalMasks[3]),
+    gather(board, kDiagonalMasks[4]),
+    (row0 << 2) | ((row1 >> 5) & 2) | ((row1 >> 1) & 1), // 1行目とB2, G2。
+    ((row0 >> 5) << 6) | ((row1 >> 5) << 3) | (row2 >> 5),
+    ((row0 >> 3) << 5) | (row1 >> 3)
+  };
+}
+
+} // namespace
+
+bool OthelloPatternEvaluator::load(const std::string& path) {
+  std::ifstream ifs(path, std::ios::binary);
+  OthelloPatternWeightsHeader header{};
+  if (!ifs.read(reinterpret_cast<char*>(&header), sizeof(header))) { return false; }
+  if (header.magic != kMagic || header.version != kVersion || header.phase_cnt != kNumberOfPhases ||
+      header.weights_per_phase != kWeightsPerPhase) {
+    return false;
+  }
+
+  std::vector<int16_t> weights(this->weights_.size());
+  if (!ifs.read(reinterpret_cast<char*>(weights.data()), weights.size() * sizeof(int16_t))) { return false; }
+  this->weights_ = std::move(weights);
+  return true;
+}
+
+bool OthelloPatternEvaluator::save(const std::string& path) const {
+  OthelloPatternWeightsHeader header{};
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.phase_cnt = kNumberOfPhases;
+  header.weights_per_phase = kWeightsPerPhase;
+
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  ofs.write(reinterpret_cast<const char*>(this->weights_.data()), this->weights_.size() * sizeof(int16_t));
+  return ofs.good();
+}
+
+std::array<double, 2> OthelloPatternEvaluator::winRates(const OthelloState& state) const {
+  const double black_win_rate{1.0 / (1.0 + std::exp(-this->evaluate(state) / kWinRateScale))};
+  return {black_win_rate, 1.0 - black_win_rate};
+}
+
+void OthelloPatternEvaluator::featureIndices(const OthelloState& state, FeatureIndices& indices) {
+  for (int symmetry = 0; symmetry < kNumberOfSymmetries; symmetry++) {
+    const auto black_bits{patternBits(OthelloState::transformBoard(state.getBlackBoard(), symmetry))};
+    const auto white_bits{patternBits(OthelloState::transformBoard(state.getWhiteBoard(), symmetry))};
+    for (int pattern = 0; pattern < kNumberOfPatterns; pattern++) {
+      indices[symmetry * kNumberOfPatterns + pattern] =
+          kPatternOffsets[pattern] + kTernary[black_bits[pattern]] + 2 * kTernary[white_bits[pattern]];
+    }
+  }
+}
+
+std::vector<float> OthelloPatternEvaluator::getWeights() const {
+  std::vector<float> result(this->weights_.size());
+  std::transform(this->weights_.begin(), this->weights_.end(), result.begin(),
+      [](const int16_t weight) { return (float)weight / kWeightScale; });
+  return result;
+}
+
+void OthelloPatternEvaluator::setWeights(const std::vector<float>& weights) {
+  std::transform(weights.begin(), weights.end(), this->weights_.begin(), [](const float weight) {
+    const long rounded{std::lround(weight * kWeightScale)};
+    return (int16_t)std::clamp<long>(rounded, INT16_MIN, INT16_MAX);
+  });
+}
+
+void trainPatternEvaluator(OthelloPatternEvaluator& evaluator, const OthelloSelfPlayReader& reader,
+                           const PatternTrainingSettings& settings, std::ostream& log) {
+  const std::size_t record_cnt{reader.size()};
+  const std::size_t validation_cnt{(std::size_t)(record_cnt * settings.validation_ratio)};
+  const std::size_t training_cnt{record_cnt - validation_cnt};
+
+  /* 学習中は丸めずに持ち、周ごとに評価器へ写す。 */
+  std::vector<float> weights{evaluator.getWeights()};
+  const auto predict{[&weights](const OthelloState& state, uint32_t& base, OthelloPatternEvaluator::FeatureIndices& indices) {
+    base = OthelloPatternEvaluator::phase(state) * OthelloPatternEvaluator::weightsPerPhase();
+    OthelloPatternEvaluator::featureIndices(state, indices);
+    double sum{weights[base + OthelloPatternEvaluator::biasIndex(state)]};
+    for (const uint32_t index : indices) {
+      sum += weights[base + index];
+    }
+    return sum;
+  }};
+  const auto makeState{[](const OthelloSelfPlayRecord& record) {
+    return OthelloState(record.black_board, record.white_board, record.cur_turn);
+  }};
+
+  std::vector<std::size_t> order(training_cnt);
+  std::iota(order.begin(), order.end(), 0);
+  std::mt19937 random_engine{settings.seed};
+
+  log << "epoch  training_mse  validation_mse" << std::endl;
+  for (int epoch = 0; epoch < settings.epoch_cnt; epoch++) {
+    std::shuffle(order.begin(), order.end(), random_engine);
+
+    double training_error{};
+    for (const std::size_t i : order) {
+      const OthelloSelfPlayRecord& record{reader[i]};
+      const OthelloState state{makeState(record)};
+      uint32_t base{};
+      OthelloPatternEvaluator::FeatureIndices indices{};
+      const double error{record.black_disk_diff - predict(state, base, indices)};
+      training_error += error * error;
+
+      const float step{(float)(settings.learning_rate * error)};
+      weights[base + OthelloPatternEvaluator::biasIndex(state)] += step;
+      for (const uint32_t index : indices) {
+        weights[base + index] += step;
+      }
+    }
+
+    double validation_error{};
+    for (std::size_t i = training_cnt; i < record_cnt; i++) {
+      const OthelloSelfPlayRecord& record{reader[i]};
+      uint32_t base{};
+      OthelloPatternEvaluator::FeatureIndices indices{};
+      const double error{record.black_disk_diff - predict(makeState(record), base, indices)};
+      validation_error += error * error;
+    }
+
+    log << std::setw(5) << epoch + 1
+        << std::setw(14) << std::fixed << std::setprecision(2) << training_error / std::max<std::size_t>(training_cnt, 1)
+        << std::setw(16) << validation_error / std::max<std::size_t>(validation_cnt, 1) << std::endl;
+  }
+  evaluator.setWeights(weights);
+}
@@ -0,0 +1,144 @@
+#ifndef OTHELLO_PATTERN_EVALUATOR_HPP_
+#define OTHELLO_PATTERN_EVALUATOR_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "othello_selfplay.hpp"
+#include "othello_state.hpp"
+#include "othello_types.hpp"
+
+/* 重みファイルの形式。 */
+/* [OthelloPatternWeightsHeader][int16_t × phase_cnt × weights_per_phase] */
+/* 重みは石差をkWeightScale倍して丸めた値。 */
+struct OthelloPatternWeightsHeader {
+  std::array<char, 8> magic; // "OTHPATT"
+  uint32_t version;
+  uint32_t phase_cnt;
+  uint32_t weights_per_phase;
+  uint32_t reserved;
+};
+
+/* マスの数がsizes[i]個のパターンの重みを順に並べたときの、各パターンの先頭の添字。クラスの定数の初期化に使うので、クラスの外に置く。 */
+template <std::size_t kNumberOfPatterns>
+constexpr std::array<uint32_t, kNumberOfPatterns + 1> othelloPatternOffsets(const std::array<int, kNumberOfPatterns>& sizes) {
+  std::array<uint32_t, kNumberOfPatterns + 1> result{};
+  for (std::size_t i = 0; i < kNumberOfPatterns; i++) {
+    uint32_t weight_cnt{1};
+    for (int j = 0; j < sizes[i]; j++) {
+      weight_cnt *= 3;
+    }
+    result[i + 1] = result[i] + weight_cnt;
+  }
+  return result;
+}
+
+/* 盤の辺・隅・斜めなどのマスの並び(パターン)の石の配置ごとに重みを持ち、その和で終局時の石差を推定する評価器。 */
+/* 配置は空・黒・白を0・1・2とする3進数の添字で表す。 */
+/* 盤を8通りに対称変換し、変換後の盤の決まった位置からパターンを取り出すので、対称なパターンは同じ重みを使う。 */
+/* 取り出しはシフトとマスク(斜めは掛け算で1行に集める)で黒と白のbit列を作り、2進数から3進数への表引きで添字にする。 */
+/* 重みは石数で分けた段階(phase)ごとに持つ。 */
+class OthelloPatternEvaluator {
+ public:
+  static constexpr std::array<char, 8> kMagic{'O', 'T', 'H', 'P', 'A', 'T', 'T', '\0'};
+  static constexpr uint32_t kVersion{1};
+
+  static constexpr int kNumberOfPhases{4};
+  static constexpr int kNumberOfSymmetries{8};
+  static constexpr int kNumberOfPatterns{11};
+  static constexpr int kNumberOfFeatures{kNumberOfSymmetries * kNumberOfPatterns}; // 1局面から取り出すパターンの数。
+
+  /* パターンのマスの数。2〜4行目、長さ8〜4の斜め、辺とX、隅の3×3、隅の2×5の順。 */
+  static constexpr std::array<int, kNumberOfPatterns> kPatternSizes{8, 8, 8, 8, 7, 6, 5, 4, 10, 9, 10};
+
+  static constexpr int kWeightScale{256}; // 石差1つあたりの重みの値。
+
+  using FeatureIndices = std::array<uint32_t, kNumberOfFeatures>;
+
+  /* 重みがすべて0なら、どの局面も0と評価する。 */
+  OthelloPatternEvaluator() : weights_(kNumberOfPhases * kWeightsPerPhase) {}
+
+  /* 重みファイルを読み込む。形式が合わなければfalseを返し、重みは変えない。 */
+  bool load(const std::string& path);
+
+  bool save(const std::string& path) const;
+
+  /* 黒から見た終局時の石差の推定値。 */
+  double evaluate(const OthelloState& state) const {
+    const uint32_t base{OthelloPatternEvaluator::phase(state) * kWeightsPerPhase};
+    FeatureIndices indices{};
+    OthelloPatternEvaluator::featureIndices(state, indices);
+
+    int32_t sum{this->weights_[base + OthelloPatternEvaluator::biasIndex(state)]};
+    for (const uint32_t index : indices) {
+      sum += this->weights_[base + index];
+    }
+    return (double)sum / kWeightScale;
+  }
+
+  /* 各局面の(黒の勝率, 白の勝率)の推定値を返す。MonteCarloTreeNode::searchBatched()用。 */
+  std::vector<std::array<double, 2>> evaluateBatch(const std::vector<OthelloState>& states) const {
+    std::vector<std::array<double, 2>> result(states.size());
+    for (std::size_t i = 0; i < states.size(); i++) {
+      result.at(i) = this->winRates(states.at(i));
+    }
+    return result;
+  }
+
+  /* (黒の勝率, 白の勝率)の推定値。 */
+  std::array<double, 2> winRates(const OthelloState& state) const;
+
+  /* 局面stateから取り出したパターンの、段階ごとの重みの中での添字。 */
+  static void featureIndices(const OthelloState& state, FeatureIndices& indices);
+
+  /* 手番ごとの定数項の、段階ごとの重みの中での添字。 */
+  static uint32_t biasIndex(const OthelloState& state) { return kNumberOfPatternWeights + state.getCurrentPlayerNum(); }
+
+  /* 石数で分けた段階。 */
+  static uint32_t phase(const OthelloState& state) {
+    const int disk_cnt{state.countDisksOf(OthelloState::kBlackTurn) + state.countDisksOf(OthelloState::kWhiteTurn)};
+    return std::min((disk_cnt - 4) * kNumberOfPhases / (OthelloState::kNumberOfSquares - 3), kNumberOfPhases - 1);
+  }
+
+  static constexpr uint32_t weightsPerPhase() { return kWeightsPerPhase; }
+
+  /* 重みを石差の単位で読み書きする。学習用。 */
+  std::vector<float> getWeights() const;
+
+  void setWeights(const std::vector<float>& weights);
+
+  /* MonteCarloTreeNode::setTruncatedPlayout()に渡す形にする。節点ごとに複製されるので、重みはevaluatorと共有する。 */
+  static std::function<std::array<double, 2>(const OthelloState&)> asPlayoutEvaluator(std::shared_ptr<const OthelloPatternEvaluator> evaluator) {
+    return [evaluator](const OthelloState& state) { return evaluator->winRates(state); };
+  }
+
+ private:
+  static constexpr std::array<uint32_t, kNumberOfPatterns + 1> kPatternOffsets{othelloPatternOffsets(kPatternSizes)}; // パターンごとの重みの先頭の添字。
+  static constexpr uint32_t kNumberOfPatternWeights{kPatternOffsets[kNumberOfPatterns]};
+  static constexpr uint32_t kWeightsPerPhase{kNumberOfPatternWeights + 2}; // パターンと、手番ごとの定数項。
+
+  static constexpr double kWinRateScale{6.0}; // 石差を勝率に変換するときの尺度。
+
+  std::vector<int16_t> weights_; // 段階ごとに kWeightsPerPhase 個ずつ並べる。
+};
+
+/* パターン評価器の学習の設定。 */
+struct PatternTrainingSettings {
+  int epoch_cnt{15};            // 棋譜全体を何周するか。
+  double learning_rate{0.0001}; // 1局面あたり、誤差(石差)にかける係数。
+  double validation_ratio{0.1}; // 棋譜の末尾から、学習に使わず誤差の確認に使う割合。
+  unsigned int seed{1};
+};
+
+/* 自己対局の棋譜の各局面について、評価値が終局時の石差に近づくように、確率的勾配降下法で重みを学習する。 */
+/* 各周の学習用と確認用の平均二乗誤差をlogへ出力する。 */
+void trainPatternEvaluator(OthelloPatternEvaluator& evaluator, const OthelloSelfPlayReader& reader,
+                           const PatternTrainingSettings& settings, std::ostream& log);
+
+#endif // OTHELLO_PATTERN_EVALUATOR_HPP_
@@ -0,0 +1,89 @@
+#include "othello_rollout_policy.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+
+#include "../../../src/softmax.hpp"
+
+bool OthelloRolloutPolicy::load(const std::string& path) {
+  std::ifstream ifs(path, std::ios::binary);
+  OthelloRolloutWeightsHeader header{};
+  if (!ifs.read(reinterpret_cast<char*>(&header), sizeof(header))) { return false; }
+  if (header.magic != kMagic || header.version != kVersion || header.weight_cnt != kNumberOfFeatures) { return false; }
+
+  std::array<float, kNumberOfFeatures> weights{};
+  if (!ifs.read(reinterpret_cast<char*>(weights.data()), sizeof(weights))) { return false; }
+  this->weights_ = weights;
+  return true;
+}
+
+bool OthelloRolloutPolicy::save(const std::string& path) const {
+  OthelloRolloutWeightsHeader header{};
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.weight_cnt = kNumberOfFeatures;
+
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  ofs.write(reinterpret_cast<const char*>(this->weights_.data()), sizeof(this->weights_));
+  return ofs.good();
+}
+
+coord OthelloRolloutPolicy::select(const OthelloState& state, XorShift64& random_engine) const {
+  const std::vector<coord> actions{state.legalActions()};
+  if (actions.size() == 1) { return actions.at(0); }
+
+  std::vector<FeatureIndices> features{};
+  std::vector<double> probabilities{};
+  this->probabilities(state, actions, features, probabilities);
+
+  /* 累積確率から選ぶ。丸め誤差で最後まで届かなければ最後の手にする。 */
+  double rest{std::uniform_real_distribution<double>(0.0, 1.0)(random_engine)};
+  for (std::size_t i = 0; i + 1 < actions.size(); i++) {
+    rest -= probabilities.at(i);
+    if (rest < 0.0) { return actions.at(i); }
+  }
+  return actions.back();
+}
+
+void OthelloRolloutPolicy::probabilities(const OthelloState& state, const std::vector<coord>& actions,
+                                         std::vector<FeatureIndices>& features, std::vector<double>& probabilities) const {
+  features.resize(actions.size());
+  std::vector<double> scores(actions.size());
+  for (std::size_t i = 0; i < actions.size(); i++) {
+    features.at(i) = featureIndices(state, actions.at(i));
+    for (const int feature : features.at(i)) {
+      scores.at(i) += this->weights_.at(feature);
+    }
+  }
+  probabilities = softmax(std::move(scores));
+}
+
+OthelloRolloutPolicy::FeatureIndices OthelloRolloutPolicy::featureIndices(const OthelloState& state, const coord& action) {
+  /* マス。左右・上下・対角線で折り返して(a, b) (0 <= a <= b < 4)にまとめる。 */
+  const int fx{std::min(action.first, 7 - action.first)};
+  const int fy{std::min(action.second, 7 - action.second)};
+  const int a{std::min(fx, fy)};
+  const int b{std::max(fx, fy)};
+  const int square_feature{a * 4 - a * (a - 1) / 2 + (b - a)};
+
+  /* 返す石の数。置いた石の分を除く。パスになっても石の数は変わらない。 */
+  const int player_num{state.getCurrentPlayerNum()};
+  const int flip_cnt{state.next(action).countDisksOf(player_num) - state.countDisksOf(player_num) - 1};
+  const int flip_feature{kNumberOfSquareFeatures + std::min(std::max(flip_cnt, 1), kNumberOfFlipFeatures) - 1};
+
+  /* 隅の周り。隅に隣接するマスなら、その隅の状態を見る。 */
+  int corner_feature{kNumberOfSquareFeatures + kNumberOfFlipFeatures + kNumberOfCornerFeatures - 1};
+  if (a <= 1 && b == 1) {
+    const coord corner((action.first < 4) ? 0 : 7, (action.second < 4) ? 0 : 7);
+    const bitboard corner_bit{OthelloState::coord2Bit(corner)};
+    const bitboard my_board{(player_num == OthelloState::kBlackTurn) ? state.getBlackBoard() : state.getWhiteBoard()};
+    const bitboard opponent_board{(player_num == OthelloState::kBlackTurn) ? state.getWhiteBoard() : state.getBlackBoard()};
+    const int corner_state{(my_board & corner_bit) ? 1 : (opponent_board & corner_bit) ? 2 : 0};
+    const int is_x_square{(a == 1) ? 1 : 0};
+    corner_feature = kNumberOfSquareFeatures + kNumberOfFlipFeatures + is_x_square * 3 + corner_state;
+  }
+
+  return FeatureIndices{square_feature, flip_feature, corner_feature};
+}
@@ -0,0 +1,74 @@
+#ifndef OTHELLO_ROLLOUT_POLICY_HPP_
+#define OTHELLO_ROLLOUT_POLICY_HPP_
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../xorshift64.hpp"
+#include "othello_state.hpp"
+#include "othello_types.hpp"
+
+/* 重みファイルの形式。 */
+/* [OthelloRolloutWeightsHeader][float × weight_cnt] */
+struct OthelloRolloutWeightsHeader {
+  std::array<char, 8> magic; // "OTHROLL"
+  uint32_t version;
+  uint32_t weight_cnt;
+};
+
+/* プレイアウト用の方策。着手ごとに安い特徴量の重みの和を得点とし、softmax()で着手の確率を決める。 */
+/* 特徴量は次の3種類で、どの着手もそれぞれの種類から1つずつ持つ。 */
+/*  - マス: 盤の対称性で同じになるマスをまとめた10種類。 */
+/*  - 返す石の数: 1〜7個と8個以上の8種類。 */
+/*  - 隅の周り: 隅に隣接するマス(C・X)への着手で、その隅が空・自分・相手のどれかの6種類と、それ以外の1種類。 */
+class OthelloRolloutPolicy {
+ public:
+  static constexpr std::array<char, 8> kMagic{'O', 'T', 'H', 'R', 'O', 'L', 'L', '\0'};
+  static constexpr uint32_t kVersion{1};
+
+  static constexpr int kNumberOfSquareFeatures{10};
+  static constexpr int kNumberOfFlipFeatures{8};
+  static constexpr int kNumberOfCornerFeatures{7};
+  static constexpr int kNumberOfFeatures{kNumberOfSquareFeatures + kNumberOfFlipFeatures + kNumberOfCornerFeatures};
+  static constexpr int kFeaturesPerAction{3};
+
+  using FeatureIndices = std::array<int, kFeaturesPerAction>;
+
+  /* 重みがすべて0なら、一様ランダムな方策と同じ。 */
+  OthelloRolloutPolicy() = default;
+
+  /* 重みファイルを読み込む。形式が合わなければfalseを返し、重みは変えない。 */
+  bool load(const std::string& path);
+
+  bool save(const std::string& path) const;
+
+  /* 局面stateで、方策に従って着手を1つ選ぶ。 */
+  coord select(const OthelloState& state, XorShift64& random_engine) const;
+
+  /* 局面stateの合法手actionsそれぞれについて、持っている特徴量と選ばれる確率を求める。 */
+  void probabilities(const OthelloState& state, const std::vector<coord>& actions,
+                     std::vector<FeatureIndices>& features, std::vector<double>& probabilities) const;
+
+  /* 着手actionが持つ特徴量の添字。 */
+  static FeatureIndices featureIndices(const OthelloState& state, const coord& action);
+
+  const std::array<float, kNumberOfFeatures>& getWeights() const { return this->weights_; }
+
+  std::array<float, kNumberOfFeatures>& getWeights() { return this->weights_; }
+
+  /* MonteCarloTreeNodeやPrimitiveMonteCarloRootのプレイアウト方策として渡す形にする。 */
+  /* 節点ごとに方策が複製されるので、重みはpolicyと共有する。 */
+  static std::function<coord(const OthelloState&, XorShift64&)> asPlayoutPolicy(std::shared_ptr<const OthelloRolloutPolicy> policy) {
+    return [policy](const OthelloState& state, XorShift64& random_engine) { return policy->select(state, random_engine); };
+  }
+
+ private:
+  std::array<float, kNumberOfFeatures> weights_{};
+};
+
+#endif // OTHELLO_ROLLOUT_POLICY_HPP_
@@ -0,0 +1,184 @@
+#include "othello_selfplay.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../monte_carlo_tree_node.hpp"
+
+namespace {
+
+constexpr std::array<char, 8> kMagic{'O', 'T', 'H', 'S', 'E', 'L', 'F', '\0'};
+constexpr uint32_t kVersion{1};
+constexpr int kSampledPlies{10}; // 探索回数に比例した確率で手を選ぶ手数。
+
+/* 1局を自己対局して、全局面のレコードを返す。 */
+std::vector<OthelloSelfPlayRecord> playGame(const int playout_limit, const unsigned int seed) {
+  XorShift64 random_engine{seed};
+  std::vector<OthelloSelfPlayRecord> records{};
+
+  OthelloState state{};
+  MonteCarloTreeNode<OthelloState, coord, 2> tree(state, state.getCurrentPlayerNum(), {-1, -1}, seed);
+  tree.setPlayoutLimit(playout_limit);
+  while (!state.isFinished()) {
+    coord action{tree.search()};
+
+    OthelloSelfPlayRecord record{};
+    record.black_board = state.getBlackBoard();
+    record.white_board = state.getWhiteBoard();
+    record.cur_turn = state.getCurrentPlayerNum();
+    int whole_visit_cnt{};
+    for (const auto& child : tree.getChildren()) {
+      const int visit_cnt{std::min(child.getPlayCount(), (int)UINT16_MAX)};
+      record.visit_cnts.at(OthelloState::actionIndex(child.getLastAction())) = visit_cnt;
+      whole_visit_cnt += visit_cnt;
+    }
+
+    /* 序盤は探索回数に比例した確率で選ぶ。 */
+    if ((int)records.size() < kSampledPlies && whole_visit_cnt > 0) {
+      int rest{(int)(random_engine() % whole_visit_cnt)};
+      for (const auto& child : tree.getChildren()) {
+        rest -= record.visit_cnts.at(OthelloState::actionIndex(child.getLastAction()));
+        if (rest < 0) {
+          action = child.getLastAction();
+          break;
+        }
+      }
+    }
+    record.best_square = OthelloState::actionIndex(action);
+    records.push_back(record);
+
+    state = state.next(action);
+    tree = tree.extractChild(action);
+  }
+
+  const int disk_diff{state.countDisksOf(OthelloState::kBlackTurn) - state.countDisksOf(OthelloState::kWhiteTurn)};
+  for (OthelloSelfPlayRecord& record : records) {
+    record.black_disk_diff = disk_diff;
+  }
+  return records;
+}
+
+} // namespace
+
+bool OthelloSelfPlayWriter::open(const std::string& path, const int playout_limit) {
+  this->close();
+
+  this->ofs_.open(path, std::ios::binary | std::ios::trunc);
+  if (!this->ofs_) { return false; }
+
+  this->header_ = OthelloSelfPlayHeader{};
+  this->header_.magic = kMagic;
+  this->header_.version = kVersion;
+  this->header_.record_size = sizeof(OthelloSelfPlayRecord);
+  this->header_.playout_limit = playout_limit;
+  this->record_cnt_ = 0;
+  this->buffer_.reserve(kBufferSize);
+  this->ofs_.write(reinterpret_cast<const char*>(&this->header_), sizeof(this->header_));
+  return this->ofs_.good();
+}
+
+bool OthelloSelfPlayWriter::appendGame(const std::vector<OthelloSelfPlayRecord>& records) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  if (!this->ofs_.is_open()) { return false; }
+
+  this->buffer_.insert(this->buffer_.end(), records.begin(), records.end());
+  this->record_cnt_ += records.size();
+  if (this->buffer_.size() >= kBufferSize) {
+    this->flush();
+  }
+  return this->ofs_.good();
+}
+
+bool OthelloSelfPlayWriter::close() {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  if (!this->ofs_.is_open()) { return false; }
+
+  this->flush();
+  this->header_.record_cnt = this->record_cnt_;
+  this->ofs_.seekp(0);
+  this->ofs_.write(reinterpret_cast<const char*>(&this->header_), sizeof(this->header_));
+  const bool is_good{this->ofs_.good()};
+  this->ofs_.close();
+  return is_good;
+}
+
+void OthelloSelfPlayWriter::flush() {
+  this->ofs_.write(reinterpret_cast<const char*>(this->buffer_.data()), this->buffer_.size() * sizeof(OthelloSelfPlayRecord));
+  this->buffer_.clear();
+}
+
+bool OthelloSelfPlayReader::open(const std::string& path) {
+  this->close();
+
+  const int fd{::open(path.c_str(), O_RDONLY)};
+  if (fd < 0) { return false; }
+
+  struct stat st{};
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(OthelloSelfPlayHeader)) {
+    ::close(fd);
+    return false;
+  }
+
+  void* mapped{mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)};
+  ::close(fd); // mmapした領域はfdを閉じても有効。
+  if (mapped == MAP_FAILED) { return false; }
+  this->mapped_ = mapped;
+  this->mapped_size_ = st.st_size;
+
+  const OthelloSelfPlayHeader& h{this->header()};
+  if (h.magic != kMagic || h.version != kVersion || h.record_size != sizeof(OthelloSelfPlayRecord)) {
+    this->close();
+    return false;
+  }
+
+  /* レコード数はファイルの大きさから求める。書き込み途中で止まったファイルでも、完全なレコードは読める。 */
+  this->records_ = reinterpret_cast<const OthelloSelfPlayRecord*>(static_cast<const char*>(this->mapped_) + sizeof(OthelloSelfPlayHeader));
+  this->record_cnt_ = (this->mapped_size_ - sizeof(OthelloSelfPlayHeader)) / sizeof(OthelloSelfPlayRecord);
+  return true;
+}
+
+void OthelloSelfPlayReader::close() {
+  if (this->mapped_ != nullptr) {
+    munmap(this->mapped_, this->mapped_size_);
+  }
+  this->mapped_ = nullptr;
+  this->mapped_size_ = 0;
+  this->records_ = nullptr;
+  this->record_cnt_ = 0;
+}
+
+bool generateSelfPlay(const std::string& path, const int game_cnt, const int playout_limit, const int num_threads,
+                      const unsigned int seed, std::ostream& log) {
+  OthelloSelfPlayWriter writer{};
+  if (!writer.open(path, playout_limit)) { return false; }
+
+  /* 対局ごとに独立なので、空いたスレッドが次の対局を取っていく。 */
+  std::atomic<int> next_game{0};
+  std::atomic<bool> is_failed{false};
+  std::mutex log_mutex{};
+  std::vector<std::thread> workers{};
+  for (int t = 0; t < std::max(num_threads, 1); t++) {
+    workers.emplace_back([&]() {
+      for (int game = next_game++; game < game_cnt && !is_failed.load(); game = next_game++) {
+        const std::vector<OthelloSelfPlayRecord> records{playGame(playout_limit, seed + game)};
+        if (!writer.appendGame(records)) {
+          is_failed.store(true);
+        }
+        std::lock_guard<std::mutex> lock(log_mutex);
+        log << "game " << game << ": " << records.size() << " positions, black - white = " << (int)records.front().black_disk_diff << std::endl;
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+
+  return writer.close() && !is_failed.load();
+}
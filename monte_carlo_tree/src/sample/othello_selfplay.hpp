@@ -0,0 +1,110 @@
+#ifndef OTHELLO_SELFPLAY_HPP_
+#define OTHELLO_SELFPLAY_HPP_
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "othello_state.hpp"
+#include "othello_types.hpp"
+
+/* 自己対局の棋譜ファイルの形式。 */
+/* [OthelloSelfPlayHeader][OthelloSelfPlayRecord × 局面数] */
+/* レコードは書き込んだ順に並び、1局分はまとめて連続する。 */
+
+struct OthelloSelfPlayHeader {
+  std::array<char, 8> magic; // "OTHSELF"
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t record_cnt;       // 正しく閉じたときに書き込む。途中で止まったファイルでは0のまま。
+  uint32_t playout_limit;    // 1手あたりのプレイアウト回数。
+  uint32_t reserved;
+};
+
+struct OthelloSelfPlayRecord {
+  bitboard black_board;
+  bitboard white_board;
+  uint8_t cur_turn;
+  int8_t black_disk_diff;             // 終局時の (黒の石数 - 白の石数)。
+  uint8_t best_square;                // 実際に打った手。A1, B1, ..., H8 の順の添字。
+  uint8_t reserved;
+  std::array<uint16_t, 64> visit_cnts; // 根の子節点の探索回数。対称な手は代表の1マスにまとめられ、合法手が1つの局面ではすべて0。
+};
+static_assert(sizeof(OthelloSelfPlayRecord) == 152, "OthelloSelfPlayRecord must stay a fixed-size record.");
+
+/* 棋譜ファイルへの書き込み。1局分ずつバッファにためて、まとめて書き出す。複数のスレッドから呼んでよい。 */
+class OthelloSelfPlayWriter {
+ public:
+  OthelloSelfPlayWriter() = default;
+
+  OthelloSelfPlayWriter(const OthelloSelfPlayWriter&) = delete;
+  OthelloSelfPlayWriter& operator=(const OthelloSelfPlayWriter&) = delete;
+
+  ~OthelloSelfPlayWriter() { this->close(); }
+
+  bool open(const std::string& path, const int playout_limit);
+
+  /* 1局分のレコードを追加する。書き込みに失敗していればfalseを返す。 */
+  bool appendGame(const std::vector<OthelloSelfPlayRecord>& records);
+
+  /* 残りを書き出し、ヘッダにレコード数を書き込んで閉じる。 */
+  bool close();
+
+  uint64_t size() const { return this->record_cnt_; }
+
+ private:
+  static constexpr std::size_t kBufferSize{4096}; // この数のレコードがたまったら書き出す。
+
+  std::ofstream ofs_{};
+  std::mutex mutex_{};
+  std::vector<OthelloSelfPlayRecord> buffer_{};
+  OthelloSelfPlayHeader header_{};
+  uint64_t record_cnt_{};
+
+  void flush();
+};
+
+/* mmapした棋譜ファイルを、コピーせずにレコードの列として読む。 */
+class OthelloSelfPlayReader {
+ public:
+  OthelloSelfPlayReader() = default;
+
+  OthelloSelfPlayReader(const OthelloSelfPlayReader&) = delete;
+  OthelloSelfPlayReader& operator=(const OthelloSelfPlayReader&) = delete;
+
+  ~OthelloSelfPlayReader() { this->close(); }
+
+  /* 形式が合わなければfalseを返す。途中で止まったファイルは、最後の完全なレコードまで読む。 */
+  bool open(const std::string& path);
+
+  void close();
+
+  bool isOpen() const { return this->mapped_ != nullptr; }
+
+  std::size_t size() const { return this->record_cnt_; }
+
+  const OthelloSelfPlayRecord* begin() const { return this->records_; }
+
+  const OthelloSelfPlayRecord* end() const { return this->records_ + this->record_cnt_; }
+
+  const OthelloSelfPlayRecord& operator[](const std::size_t i) const { return this->records_[i]; }
+
+  const OthelloSelfPlayHeader& header() const { return *static_cast<const OthelloSelfPlayHeader*>(this->mapped_); }
+
+ private:
+  void* mapped_{nullptr};
+  std::size_t mapped_size_{};
+  const OthelloSelfPlayRecord* records_{nullptr};
+  std::size_t record_cnt_{};
+};
+
+/* 両方の手番をモンテカルロ木探索にしてgame_cnt局を自己対局し、全局面を棋譜ファイルに書き出す。 */
+/* 序盤のkSampledPlies手は探索回数に比例した確率で手を選び、同じ対局ばかりにならないようにする。 */
+bool generateSelfPlay(const std::string& path, const int game_cnt, const int playout_limit, const int num_threads,
+                      const unsigned int seed, std::ostream& log);
+
+#endif // OTHELLO_SELFPLAY_HPP_
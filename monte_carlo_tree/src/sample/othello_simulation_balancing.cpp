@@ -0,0 +1,157 @@
+#include "othello_simulation_balancing.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../monte_carlo_tree_node.hpp"
+
+namespace {
+
+constexpr int kMinPositionPlies{8};   // 学習に使う局面の手数の下限。
+constexpr int kMaxPositionPlies{50};  // 上限。
+
+using Gradient = std::array<double, OthelloRolloutPolicy::kNumberOfFeatures>;
+
+/* 学習に使う局面と、その局面での黒のMinMaxの推定値。 */
+struct TrainingPosition {
+  OthelloState state;
+  double target;
+};
+
+/* 局面ごとに独立な処理を、num_threads並列で空いたスレッドが順に取っていく。 */
+template <class Function>
+void parallelFor(const int size, const int num_threads, const Function& function) {
+  std::atomic<int> next_index{0};
+  std::vector<std::thread> workers{};
+  for (int t = 0; t < std::max(num_threads, 1); t++) {
+    workers.emplace_back([&, t]() {
+      for (int i = next_index++; i < size; i = next_index++) {
+        function(t, i);
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
+
+/* 初期局面からランダムに進めた局面を集め、探索でMinMaxの推定値を付ける。 */
+std::vector<TrainingPosition> makeTrainingPositions(const SimulationBalancingSettings& settings) {
+  XorShift64 random_engine{settings.seed};
+  std::vector<TrainingPosition> positions{};
+  while ((int)positions.size() < settings.position_cnt) {
+    const int plies{kMinPositionPlies + (int)(random_engine() % (kMaxPositionPlies - kMinPositionPlies + 1))};
+    OthelloState state{};
+    for (int i = 0; i < plies && !state.isFinished(); i++) {
+      const std::vector<coord> actions{state.legalActions()};
+      state = state.next(actions.at(random_engine() % actions.size()));
+    }
+    /* 手が1つしかない局面は探索されず、推定値が付かない。 */
+    if (state.isFinished() || state.countLegalActions() <= 1) { continue; }
+    positions.push_back(TrainingPosition{state, 0.0});
+  }
+
+  parallelFor(positions.size(), settings.num_threads, [&](int, const int i) {
+    TrainingPosition& position{positions.at(i)};
+    MonteCarloTreeNode<OthelloState, coord, 2> node(position.state, position.state.getCurrentPlayerNum(), {-1, -1}, settings.seed + i);
+    node.setPlayoutLimit(settings.target_playout_limit);
+    node.search();
+    position.target = node.getEstimatedMinMaxScore(OthelloState::kBlackTurn);
+  });
+
+  /* 1つでもNaNが混ざると、勾配を通じてすべての重みに広がるので、有限でない推定値の局面は使わない。 */
+  positions.erase(std::remove_if(positions.begin(), positions.end(),
+      [](const TrainingPosition& position) { return !std::isfinite(position.target); }), positions.end());
+  return positions;
+}
+
+/* policyでstateから終局までプレイアウトし、黒の得点を返す。gradientを渡すと、選んだ手の対数尤度の勾配を足し込む。 */
+double playout(const OthelloRolloutPolicy& policy, OthelloState state, XorShift64& random_engine, Gradient* gradient) {
+  std::vector<OthelloRolloutPolicy::FeatureIndices> features{};
+  std::vector<double> probabilities{};
+  while (!state.isFinished()) {
+    const std::vector<coord> actions{state.legalActions()};
+    policy.probabilities(state, actions, features, probabilities);
+
+    std::size_t chosen{actions.size() - 1};
+    double rest{std::uniform_real_distribution<double>(0.0, 1.0)(random_engine)};
+    for (std::size_t i = 0; i + 1 < actions.size(); i++) {
+      rest -= probabilities.at(i);
+      if (rest < 0.0) {
+        chosen = i;
+        break;
+      }
+    }
+
+    /* ∇log π(a|s) = φ(s, a) - Σ_b π(b|s) φ(s, b) */
+    if (gradient != nullptr) {
+      for (const int feature : features.at(chosen)) {
+        gradient->at(feature) += 1.0;
+      }
+      for (std::size_t i = 0; i < actions.size(); i++) {
+        for (const int feature : features.at(i)) {
+          gradient->at(feature) -= probabilities.at(i);
+        }
+      }
+    }
+
+    state = state.next(actions.at(chosen));
+  }
+  return state.getScore(OthelloState::kBlackTurn);
+}
+
+} // namespace
+
+void trainRolloutPolicy(OthelloRolloutPolicy& policy, const SimulationBalancingSettings& settings, std::ostream& log) {
+  const std::vector<TrainingPosition> positions{makeTrainingPositions(settings)};
+  const int num_threads{std::max(settings.num_threads, 1)};
+  if (positions.empty()) { return; }
+
+  log << "iteration  mse" << std::endl;
+  for (int iteration = 0; iteration < settings.iteration_cnt; iteration++) {
+    /* 反復中は重みを変えず、スレッドごとに集めた更新量を最後に足す。 */
+    std::vector<Gradient> updates(num_threads);
+    std::vector<double> squared_errors(num_threads);
+    parallelFor(positions.size(), num_threads, [&](const int t, const int i) {
+      const TrainingPosition& position{positions.at(i)};
+      XorShift64 random_engine{settings.seed + (unsigned int)(iteration * positions.size() + i) * 2654435761u};
+
+      /* 方策での平均得点。 */
+      double value{};
+      for (int k = 0; k < settings.value_playout_cnt; k++) {
+        value += playout(policy, position.state, random_engine, nullptr);
+      }
+      value /= settings.value_playout_cnt;
+
+      /* 平均得点の勾配 E[z ∇log π(軌跡)]。平均得点とは別のプレイアウトで見積もる。 */
+      Gradient gradient{};
+      for (int k = 0; k < settings.gradient_playout_cnt; k++) {
+        Gradient log_likelihood_gradient{};
+        const double score{playout(policy, position.state, random_engine, &log_likelihood_gradient)};
+        for (int f = 0; f < OthelloRolloutPolicy::kNumberOfFeatures; f++) {
+          gradient.at(f) += score * log_likelihood_gradient.at(f) / settings.gradient_playout_cnt;
+        }
+      }
+
+      const double error{position.target - value};
+      squared_errors.at(t) += error * error;
+      for (int f = 0; f < OthelloRolloutPolicy::kNumberOfFeatures; f++) {
+        updates.at(t).at(f) += error * gradient.at(f);
+      }
+    });
+
+    double squared_error{};
+    for (int t = 0; t < num_threads; t++) {
+      squared_error += squared_errors.at(t);
+      for (int f = 0; f < OthelloRolloutPolicy::kNumberOfFeatures; f++) {
+        policy.getWeights().at(f) += settings.learning_rate * updates.at(t).at(f) / positions.size();
+      }
+    }
+    log << std::setw(9) << iteration << std::setw(10) << std::fixed << std::setprecision(5) << squared_error / positions.size() << std::endl;
+  }
+}
@@ -0,0 +1,26 @@
+#ifndef OTHELLO_SIMULATION_BALANCING_HPP_
+#define OTHELLO_SIMULATION_BALANCING_HPP_
+
+#include <iostream>
+
+#include "othello_rollout_policy.hpp"
+
+/* Simulation Balancingの設定。 */
+struct SimulationBalancingSettings {
+  int position_cnt{200};           // 学習に使う局面の数。
+  int target_playout_limit{5000};  // 目標値(MinMaxの推定値)を求める探索のプレイアウト回数。
+  int value_playout_cnt{32};       // 方策での勝率の推定に使う、1局面あたりのプレイアウト回数。
+  int gradient_playout_cnt{32};    // 勾配の推定に使う、1局面あたりのプレイアウト回数。
+  int iteration_cnt{50};           // 重みを更新する回数。
+  double learning_rate{10.0};      // 1局面あたりの勾配にかける係数。
+  int num_threads{1};
+  unsigned int seed{1};
+};
+
+/* policyの重みをSimulation Balancing(方策勾配法)で学習する。 */
+/* 対局途中の局面を集めてモンテカルロ木探索でMinMaxの推定値を求めておき、 */
+/* 方策でのプレイアウトの平均得点がそれに近づくように、局面ごとに (推定値 - 平均得点) × 勾配 の向きへ重みを動かす。 */
+/* 各反復の誤差をlogへ出力する。 */
+void trainRolloutPolicy(OthelloRolloutPolicy& policy, const SimulationBalancingSettings& settings, std::ostream& log);
+
+#endif // OTHELLO_SIMULATION_BALANCING_HPP_
@@ -0,0 +1,75 @@
+#include "othello_solver.hpp"
+
+#include <algorithm>
+#include <limits>
+
+bool OthelloEndgameSolver::solve(const OthelloState& state, const Clock::time_point deadline, coord& best_action, int& score) {
+  this->node_cnt_ = 0;
+  this->deadline_ = deadline;
+  this->is_aborted_ = false;
+
+  /* 1手ごとに空きマスが1つ埋まり、パスは手を打ったときに済むので、深さは空きマスの数を超えない。 */
+  this->actions_.resize(OthelloState::kNumberOfSquares + 1);
+
+  OthelloState root{state};
+  square_index best_square{kPassSquare};
+  const int result{this->negamax(root, -OthelloState::kNumberOfSquares - 1, OthelloState::kNumberOfSquares + 1, 0, best_square)};
+  if (this->is_aborted_ || best_square == kPassSquare) { return false; }
+
+  best_action = OthelloState::square2Coord(best_square);
+  score = result;
+  return true;
+}
+
+int OthelloEndgameSolver::negamax(OthelloState& state, int alpha, const int beta, const int depth, square_index& best_action) {
+  if (++this->node_cnt_ % kDeadlineCheckInterval == 0 && Clock::now() >= this->deadline_) {
+    this->is_aborted_ = true;
+  }
+  if (this->is_aborted_) { return 0; }
+
+  const int player{state.getCurrentPlayerNum()};
+  const int opponent{(player == OthelloState::kBlackTurn) ? OthelloState::kWhiteTurn : OthelloState::kBlackTurn};
+
+  /* 手を打つとパスは済むので、合法手がなければ終局。 */
+  state.legalActions(this->squares_);
+  if (this->squares_.empty()) {
+    return state.countDisksOf(player) - state.countDisksOf(opponent);
+  }
+
+  std::vector<std::pair<int, square_index>>& actions{this->actions_.at(depth)};
+  actions.clear();
+  const int empty_cnt{OthelloState::kNumberOfSquares - state.countDisksOf(player) - state.countDisksOf(opponent)};
+  for (const square_index square : this->squares_) {
+    int key{};
+    if (empty_cnt > kOrderingEmpties) {
+      /* 相手がパスになる手を最初に読む。 */
+      const OthelloState::UndoInfo info{state.apply(square)};
+      key = (state.getCurrentPlayerNum() == player) ? -1 : state.countLegalActions();
+      state.undo(square, info);
+    }
+    actions.emplace_back(key, square);
+  }
+  if (empty_cnt > kOrderingEmpties) {
+    std::stable_sort(actions.begin(), actions.end(),
+        [](const std::pair<int, square_index>& a, const std::pair<int, square_index>& b) { return a.first < b.first; });
+  }
+
+  int best_score{std::numeric_limits<int>::min()};
+  for (const auto& [key, square] : actions) {
+    const OthelloState::UndoInfo info{state.apply(square)};
+    square_index child_best_action{};
+    const int child_score{(state.getCurrentPlayerNum() == player)
+        ? this->negamax(state, alpha, beta, depth + 1, child_best_action)
+        : -this->negamax(state, -beta, -alpha, depth + 1, child_best_action)};
+    state.undo(square, info);
+    if (this->is_aborted_) { return 0; }
+
+    if (child_score > best_score) {
+      best_score = child_score;
+      best_action = square;
+    }
+    alpha = std::max(alpha, child_score);
+    if (alpha >= beta) { break; }
+  }
+  return best_score;
+}
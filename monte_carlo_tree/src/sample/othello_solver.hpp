@@ -0,0 +1,39 @@
+#ifndef OTHELLO_SOLVER_HPP_
+#define OTHELLO_SOLVER_HPP_
+
+#include <chrono>
+#include <utility>
+#include <vector>
+
+#include "othello_state.hpp"
+#include "othello_types.hpp"
+
+/* 終局まで読み切って、最善手と終局時の石差を求める。 */
+/* 石差は手番のプレイヤから見た(自分の石数 - 相手の石数)で、空きマスはどちらにも数えない。 */
+/* αβ法で、空きマスが kOrderingEmpties より多い局面では、相手の合法手が少なくなる手から読む。 */
+class OthelloEndgameSolver {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /* stateを読み切り、最善手をbest_actionに、石差をscoreに入れる。deadlineまでに読み切れなければfalseを返す。 */
+  /* stateは合法手のある局面でなければならない。 */
+  bool solve(const OthelloState& state, const Clock::time_point deadline, coord& best_action, int& score);
+
+  /* 直前のsolve()で調べた局面の数。 */
+  long long getNodeCount() const { return this->node_cnt_; }
+
+ private:
+  static constexpr int kOrderingEmpties{7};
+  static constexpr int kDeadlineCheckInterval{4096}; // 何局面ごとに時刻を確かめるか。
+
+  long long node_cnt_{};
+  Clock::time_point deadline_{};
+  bool is_aborted_{};
+  std::vector<square_index> squares_{}; // 合法手を書き出す作業用。
+  std::vector<std::vector<std::pair<int, square_index>>> actions_{}; // 深さごとの(並べ替えの鍵, 合法手)。
+
+  /* stateの手番のプレイヤから見た石差。best_actionには最善手を入れる。 */
+  int negamax(OthelloState& state, int alpha, const int beta, const int depth, square_index& best_action);
+};
+
+#endif // OTHELLO_SOLVER_HPP_
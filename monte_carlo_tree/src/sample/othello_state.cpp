@@ -1,94 +1,162 @@
 #include "othello_state.hpp"
 
-const std::array<bitboard, 64> OthelloState::kSquare{
-    0x80'00'00'00'00'00'00'00, 0x40'00'00'00'00'00'00'00,
-    0x20'00'00'00'00'00'00'00, 0x10'00'00'00'00'00'00'00,
-    0x08'00'00'00'00'00'00'00, 0x04'00'00'00'00'00'00'00,
-    0x02'00'00'00'00'00'00'00, 0x01'00'00'00'00'00'00'00,
-    0x00'80'00'00'00'00'00'00, 0x00'40'00'00'00'00'00'00,
-    0x00'20'00'00'00'00'00'00, 0x00'10'00'00'00'00'00'00,
-    0x00'08'00'00'00'00'00'00, 0x00'04'00'00'00'00'00'00,
-    0x00'02'00'00'00'00'00'00, 0x00'01'00'00'00'00'00'00,
-    0x00'00'80'00'00'00'00'00, 0x00'00'40'00'00'00'00'00,
-    0x00'00'20'00'00'00'00'00, 0x00'00'10'00'00'00'00'00,
-    0x00'00'08'00'00'00'00'00, 0x00'00'04'00'00'00'00'00,
-    0x00'00'02'00'00'00'00'00, 0x00'00'01'00'00'00'00'00,
-    0x00'00'00'80'00'00'00'00, 0x00'00'00'40'00'00'00'00,
-    0x00'00'00'20'00'00'00'00, 0x00'00'00'10'00'00'00'00,
-    0x00'00'00'08'00'00'00'00, 0x00'00'00'04'00'00'00'00,
-    0x00'00'00'02'00'00'00'00, 0x00'00'00'01'00'00'00'00,
-    0x00'00'00'00'80'00'00'00, 0x00'00'00'00'40'00'00'00,
-    0x00'00'00'00'20'00'00'00, 0x00'00'00'00'10'00'00'00,
-    0x00'00'00'00'08'00'00'00, 0x00'00'00'00'04'00'00'00,
-    0x00'00'00'00'02'00'00'00, 0x00'00'00'00'01'00'00'00,
-    0x00'00'00'00'00'80'00'00, 0x00'00'00'00'00'40'00'00,
-    0x00'00'00'00'00'20'00'00, 0x00'00'00'00'00'10'00'00,
-    0x00'00'00'00'00'08'00'00, 0x00'00'00'00'00'04'00'00,
-    0x00'00'00'00'00'02'00'00, 0x00'00'00'00'00'01'00'00,
-    0x00'00'00'00'00'00'80'00, 0x00'00'00'00'00'00'40'00,
-    0x00'00'00'00'00'00'20'00, 0x00'00'00'00'00'00'10'00,
-    0x00'00'00'00'00'00'08'00, 0x00'00'00'00'00'00'04'00,
-    0x00'00'00'00'00'00'02'00, 0x00'00'00'00'00'00'01'00,
-    0x00'00'00'00'00'00'00'80, 0x00'00'00'00'00'00'00'40,
-    0x00'00'00'00'00'00'00'20, 0x00'00'00'00'00'00'00'10,
-    0x00'00'00'00'00'00'00'08, 0x00'00'00'00'00'00'00'04,
-    0x00'00'00'00'00'00'00'02, 0x00'00'00'00'00'00'00'01};
-
-OthelloState OthelloState::next(const coord& action) const {
-  const bitboard put{coord2Bit(action)};
-
-  bitboard my_board{};
-  bitboard opponent_board{};
-  if (this->cur_turn_ == OthelloState::kBlackTurn) {
+template <int kBoardSize>
+BasicOthelloState<kBoardSize> BasicOthelloState<kBoardSize>::next(const coord& action) const {
+  BasicOthelloState result{*this};
+  result.apply(action);
+  return result;
+}
+
+template <int kBoardSize>
+BasicOthelloState<kBoardSize> BasicOthelloState<kBoardSize>::next(const square_index action) const {
+  BasicOthelloState result{*this};
+  result.apply(action);
+  return result;
+}
+
+template <int kBoardSize>
+typename BasicOthelloState<kBoardSize>::UndoInfo BasicOthelloState<kBoardSize>::applyBit(const bitboard_type put) {
+  const UndoInfo info{this->reversedSquares(put), this->cur_turn_};
+
+  /* 置いた石と反転した石をXORで書き換える。 */
+  if (this->cur_turn_ == BasicOthelloState::kBlackTurn) {
+    this->black_board_ ^= (put | info.reversed_squares);
+    this->white_board_ ^= info.reversed_squares;
+    this->cur_turn_ = kWhiteTurn;
+  } else {
+    this->white_board_ ^= (put | info.reversed_squares);
+    this->black_board_ ^= info.reversed_squares;
+    this->cur_turn_ = kBlackTurn;
+  }
+
+  if (this->isPass()) {
+    this->cur_turn_ = (this->cur_turn_ == BasicOthelloState::kBlackTurn) ? BasicOthelloState::kWhiteTurn : BasicOthelloState::kBlackTurn;
+  }
+
+  return info;
+}
+
+template <int kBoardSize>
+void BasicOthelloState<kBoardSize>::undoBit(const bitboard_type put, const UndoInfo& info) {
+  /* 同じXORをもう一度かければ元に戻る。 */
+  if (info.cur_turn == BasicOthelloState::kBlackTurn) {
+    this->black_board_ ^= (put | info.reversed_squares);
+    this->white_board_ ^= info.reversed_squares;
+  } else {
+    this->white_board_ ^= (put | info.reversed_squares);
+    this->black_board_ ^= info.reversed_squares;
+  }
+  this->cur_turn_ = info.cur_turn;
+}
+
+template <int kBoardSize>
+typename BasicOthelloState<kBoardSize>::bitboard_type BasicOthelloState<kBoardSize>::reversedSquares(const bitboard_type put) const {
+  bitboard_type my_board{};
+  bitboard_type opponent_board{};
+  if (this->cur_turn_ == BasicOthelloState::kBlackTurn) {
     my_board = this->black_board_;
     opponent_board = this->white_board_;
   } else {
     my_board = this->white_board_;
     opponent_board = this->black_board_;
   }
-  bitboard reversed_squares{};
+  bitboard_type reversed_squares{};
 
   /* putが置かれることで反転される箇所を8方向に走査する。 */
   for (int i = 0; i < 8; i++) {
-    bitboard reversed_line{};  // ある1方向において反転された箇所の全体。
-    bitboard cur_square{this->nextSquare(put, i)};  // 反転可能性を見るマス。
-    while ((cur_square != (bitboard)0) &&
-           ((cur_square & opponent_board) != (bitboard)0)) {
+    bitboard_type reversed_line{};  // ある1方向において反転された箇所の全体。
+    bitboard_type cur_square{this->nextSquare(put, i)};  // 反転可能性を見るマス。
+    while ((cur_square != (bitboard_type)0) &&
+           ((cur_square & opponent_board) != (bitboard_type)0)) {
       reversed_line |= cur_square;
       cur_square = nextSquare(cur_square, i);
     }
     /* 反転できそうなマスの列(reversed_line)の先に自分の石があれば、反転できる。 */
-    if ((cur_square & my_board) != (bitboard)0) {
+    if ((cur_square & my_board) != (bitboard_type)0) {
       reversed_squares |= reversed_line;
     }
   }
 
-  my_board ^= (put | reversed_squares);
-  opponent_board ^= reversed_squares;
+  return reversed_squares;
+}
 
-  OthelloState result{*this};
-  if (this->cur_turn_ == OthelloState::kBlackTurn) {
-    result.cur_turn_ = kWhiteTurn;
-    result.black_board_ = my_board;
-    result.white_board_ = opponent_board;
-  } else {
-    result.cur_turn_ = kBlackTurn;
-    result.black_board_ = opponent_board;
-    result.white_board_ = my_board;
+template <int kBoardSize>
+int BasicOthelloState<kBoardSize>::canonicalSymmetry() const {
+  int best_symmetry{0};
+  bitboard_type best_black{this->black_board_};
+  bitboard_type best_white{this->white_board_};
+  for (int symmetry = 1; symmetry < 8; symmetry++) {
+    const bitboard_type black{transformBoard(this->black_board_, symmetry)};
+    const bitboard_type white{transformBoard(this->white_board_, symmetry)};
+    if (black < best_black || (black == best_black && white < best_white)) {
+      best_symmetry = symmetry;
+      best_black = black;
+      best_white = white;
+    }
   }
+  return best_symmetry;
+}
 
-  if (result.isPass()) {
-    result.cur_turn_ = (result.cur_turn_ == OthelloState::kBlackTurn) ? OthelloState::kWhiteTurn : OthelloState::kBlackTurn;
+template <int kBoardSize>
+bool BasicOthelloState<kBoardSize>::isSymmetric() const {
+  for (int symmetry = 1; symmetry < 8; symmetry++) {
+    if (transformBoard(this->black_board_, symmetry) == this->black_board_ &&
+        transformBoard(this->white_board_, symmetry) == this->white_board_) {
+      return true;
+    }
   }
+  return false;
+}
 
-  return result;
+template <int kBoardSize>
+typename BasicOthelloState<kBoardSize>::bitboard_type BasicOthelloState<kBoardSize>::transformBoard(bitboard_type board, const int symmetry) {
+  /* 8×8以外の盤は、石を1つずつ移す。 */
+  if constexpr (kBoardSize != 8) {
+    bitboard_type result{};
+    while (board != (bitboard_type)0) {
+      const bitboard_type put{board & (~board + 1)}; // 最下位の石。
+      board ^= put;
+      auto [x, y] = bit2Coord(put);
+      if (symmetry & 4) { std::swap(x, y); }
+      if (symmetry & 1) { x = kBoardSize - 1 - x; }
+      if (symmetry & 2) { y = kBoardSize - 1 - y; }
+      result |= coord2Bit(coord(x, y));
+    }
+    return result;
+  } else {
+    /* 転置。3回のdelta swapで、対角線を挟んで向かい合うbitを入れ替える。 */
+    if (symmetry & 4) {
+      bitboard_type tmp{};
+      tmp = 0x0f0f0f0f00000000 & (board ^ (board << 28));
+      board ^= tmp ^ (tmp >> 28);
+      tmp = 0x3333000033330000 & (board ^ (board << 14));
+      board ^= tmp ^ (tmp >> 14);
+      tmp = 0x5500550055005500 & (board ^ (board << 7));
+      board ^= tmp ^ (tmp >> 7);
+    }
+
+    /* 左右反転。各行の中で1bit・2bits・4bits単位に入れ替える。 */
+    if (symmetry & 1) {
+      board = ((board >> 1) & 0x5555555555555555) | ((board & 0x5555555555555555) << 1);
+      board = ((board >> 2) & 0x3333333333333333) | ((board & 0x3333333333333333) << 2);
+      board = ((board >> 4) & 0x0f0f0f0f0f0f0f0f) | ((board & 0x0f0f0f0f0f0f0f0f) << 4);
+    }
+
+    /* 上下反転。1行が1バイトなので、バイト順を逆にすればよい。 */
+    if (symmetry & 2) {
+      board = __builtin_bswap64(board);
+    }
+
+    return board;
+  }
 }
 
-std::vector<coord> OthelloState::legalActions() const {
+template <int kBoardSize>
+std::vector<coord> BasicOthelloState<kBoardSize>::legalActions() const {
   std::vector<coord> result{};
-  bitboard tmp{this->legalBoard()};
-  for (int i = 7; i >= 0; i--) {
-    for (int j = 7; j >= 0; j--) {
+  bitboard_type tmp{this->legalBoard()};
+  for (int i = kBoardSize - 1; i >= 0; i--) {
+    for (int j = kBoardSize - 1; j >= 0; j--) {
       if (tmp % 2 == 1) {
         result.push_back(coord(j, i));
       }
@@ -98,71 +166,68 @@ std::vector<coord> OthelloState::legalActions() const {
   return result;
 }
 
-bool OthelloState::isFinished() const {
+template <int kBoardSize>
+void BasicOthelloState<kBoardSize>::legalActions(std::vector<square_index>& actions) const {
+  bitboard_type tmp{this->legalBoard()};
+  actions.resize(count(tmp));
+
+  /* 最下位bitから取り出すので、legalActions()と同じく最後のマスから並ぶ。 */
+  for (square_index& action : actions) {
+    action = (square_index)(kNumberOfSquares - 1 - countTrailingZeros(tmp));
+    tmp &= tmp - 1;
+  }
+}
+
+template <int kBoardSize>
+bool BasicOthelloState<kBoardSize>::isFinished() const {
   /* 現在手番の合法手全体。 */
-  const bitboard my_legal_board{this->legalBoard()};
+  const bitboard_type my_legal_board{this->legalBoard()};
 
   /* 次手番の合法手全体。 */
-  OthelloState next_state{OthelloState(*this)};
-  next_state.cur_turn_ = (this->cur_turn_ == OthelloState::kBlackTurn) ? kWhiteTurn : kBlackTurn;
-  const bitboard opponent_legal_board{next_state.legalBoard()};
+  BasicOthelloState next_state{BasicOthelloState(*this)};
+  next_state.cur_turn_ = (this->cur_turn_ == BasicOthelloState::kBlackTurn) ? kWhiteTurn : kBlackTurn;
+  const bitboard_type opponent_legal_board{next_state.legalBoard()};
 
   /* 現在手番だけで合法手がなければ、パス。次手番でも合法手がなければ、終局。 */
-  return my_legal_board == (bitboard)0 && opponent_legal_board == (bitboard)0;
+  return my_legal_board == (bitboard_type)0 && opponent_legal_board == (bitboard_type)0;
 }
 
-int OthelloState::getScore(const int player_num) const {
+template <int kBoardSize>
+int BasicOthelloState<kBoardSize>::getScore(const int player_num) const {
   if (!this->isFinished()) {
     return 0;
   }
 
-  if (OthelloState::count(this->black_board_) ==
-      OthelloState::count(this->white_board_)) {
+  if (BasicOthelloState::count(this->black_board_) ==
+      BasicOthelloState::count(this->white_board_)) {
     return 0;
   }
 
-  if (player_num == OthelloState::kBlackTurn) {
-    return (OthelloState::count(this->black_board_) > OthelloState::count(this->white_board_)) ? 1 : 0;
+  if (player_num == BasicOthelloState::kBlackTurn) {
+    return (BasicOthelloState::count(this->black_board_) > BasicOthelloState::count(this->white_board_)) ? 1 : 0;
   } else {
-    return (OthelloState::count(this->black_board_) < OthelloState::count(this->white_board_)) ? 1 : 0;
+    return (BasicOthelloState::count(this->black_board_) < BasicOthelloState::count(this->white_board_)) ? 1 : 0;
   }
 }
 
-std::string OthelloState::board2String() const {
-  std::vector<int> squares{};
-  bitboard tmp_black{this->black_board_};
-  bitboard tmp_white{this->white_board_};
-
-  std::string result{};
-
-  for (int i = 0; i < 8; i++) {
-    for (int j = 0; j < 8; j++) {
-      if (tmp_black % 2 == 1) {
-        squares.push_back(1);
-      } else if (tmp_white % 2 == 1) {
-        squares.push_back(-1);
-      } else {
-        squares.push_back(0);
-      }
-      tmp_black >>= 1;
-      tmp_white >>= 1;
-    }
+template <int kBoardSize>
+std::string BasicOthelloState<kBoardSize>::board2String() const {
+  std::string result{" "};
+  for (int x = 0; x < kBoardSize; x++) {
+    result.push_back('A' + x);
   }
-
-  result += " ABCDEFGH\n";
-  for (int i = 7; i >= 0; i--) {
-    result += std::to_string(8 - i);
-    for (int j = 7; j >= 0; j--) {
-      switch (squares.at(8 * i + j)) {
-        case 1:
-          result += "X";
-          break;
-        case -1:
-          result += "O";
-          break;
-        default:
-          result += "-";
-          break;
+  result += "\n";
+
+  for (int y = 0; y < kBoardSize; y++) {
+    result += std::to_string(y + 1);
+    for (int x = 0; x < kBoardSize; x++) {
+      const bitboard_type square{coord2Bit(coord(x, y))};
+      if ((this->black_board_ & square) != (bitboard_type)0) {
+        result += "X";
+      } else if ((this->white_board_ & square) != (bitboard_type)0) {
+        result += "O";
+      } else {
+        result += "-";
       }
     }
     result += "\n";
@@ -170,102 +235,49 @@ std::string OthelloState::board2String() const {
   return result;
 };
 
-coord OthelloState::str2Coord(std::string str) {
-  if (str.size() != 2) {
+template <int kBoardSize>
+coord BasicOthelloState<kBoardSize>::str2Coord(std::string str) {
+  /* 列は'a'から、行は1から数える。 */
+  if (str.size() < 2) {
     return {-1, -1};
   }
 
-  coord c{};
-  if (str.at(0) == 'a') {
-    c.first = 0;
-  } else if (str.at(0) == 'b') {
-    c.first = 1;
-  } else if (str.at(0) == 'c') {
-    c.first = 2;
-  } else if (str.at(0) == 'd') {
-    c.first = 3;
-  } else if (str.at(0) == 'e') {
-    c.first = 4;
-  } else if (str.at(0) == 'f') {
-    c.first = 5;
-  } else if (str.at(0) == 'g') {
-    c.first = 6;
-  } else if (str.at(0) == 'h') {
-    c.first = 7;
-  } else {
+  const int x{str.at(0) - 'a'};
+  if (x < 0 || x >= kBoardSize) {
     return {-1, -1};
   }
-  if (str.at(1) == '1') {
-    c.second = 0;
-  } else if (str.at(1) == '2') {
-    c.second = 1;
-  } else if (str.at(1) == '3') {
-    c.second = 2;
-  } else if (str.at(1) == '4') {
-    c.second = 3;
-  } else if (str.at(1) == '5') {
-    c.second = 4;
-  } else if (str.at(1) == '6') {
-    c.second = 5;
-  } else if (str.at(1) == '7') {
-    c.second = 6;
-  } else if (str.at(1) == '8') {
-    c.second = 7;
-  } else {
+
+  int y{};
+  for (std::size_t i = 1; i < str.size(); i++) {
+    if (str.at(i) < '0' || str.at(i) > '9') {
+      return {-1, -1};
+    }
+    y = y * 10 + (str.at(i) - '0');
+  }
+  if (y < 1 || y > kBoardSize) {
     return {-1, -1};
   }
 
-  return c;
+  return coord(x, y - 1);
 }
 
-std::string coord2Str(coord c) {
-  std::string s{};
-  if (c.first == 0) {
-    s.push_back('a');
-  } else if (c.first == 1) {
-    s.push_back('b');
-  } else if (c.first == 2) {
-    s.push_back('c');
-  } else if (c.first == 3) {
-    s.push_back('d');
-  } else if (c.first == 4) {
-    s.push_back('e');
-  } else if (c.first == 5) {
-    s.push_back('f');
-  } else if (c.first == 6) {
-    s.push_back('g');
-  } else if (c.first == 7) {
-    s.push_back('h');
-  } else {
-    return "";
-  }
-  if (c.second == 0) {
-    s.push_back('1');
-  } else if (c.second == 1) {
-    s.push_back('2');
-  } else if (c.second == 2) {
-    s.push_back('3');
-  } else if (c.second == 3) {
-    s.push_back('4');
-  } else if (c.second == 4) {
-    s.push_back('5');
-  } else if (c.second == 5) {
-    s.push_back('6');
-  } else if (c.second == 6) {
-    s.push_back('7');
-  } else if (c.second == 7) {
-    s.push_back('8');
-  } else {
+template <int kBoardSize>
+std::string BasicOthelloState<kBoardSize>::coord2Str(coord c) {
+  if (c.first < 0 || c.first >= kBoardSize || c.second < 0 || c.second >= kBoardSize) {
     return "";
   }
 
+  std::string s{};
+  s.push_back('a' + c.first);
+  s += std::to_string(c.second + 1);
   return s;
 }
 
-bitboard OthelloState::legalBoard() const {
-  bitboard my_board{};
-  bitboard opponent_board{};
-  if (this->cur_turn_ == OthelloState::kBlackTurn) {
+template <int kBoardSize>
+typename BasicOthelloState<kBoardSize>::bitboard_type BasicOthelloState<kBoardSize>::legalBoard() const {
+  bitboard_type my_board{};
+  bitboard_type opponent_board{};
+  if (this->cur_turn_ == BasicOthelloState::kBlackTurn) {
     my_board = this->black_board_;
     opponent_board = this->white_board_;
   } else {
@@ -275,21 +287,21 @@ bitboard OthelloState::legalBoard() const {
 
   /* 左右方向・上下方向・斜め方向にそれぞれ挟めるマス全体。端は挟めないので積をとって除いている。
    */
-  const bitboard horizontal_sandwichable_squares = opponent_board & 0x7e7e7e7e7e7e7e7e;
-  const bitboard vertical_sandwichable_squares = opponent_board & 0x00FFFFFFFFFFFF00;
-  const bitboard diagonal_sandwichable_squares = opponent_board & 0x007e7e7e7e7e7e00;
+  const bitboard_type horizontal_sandwichable_squares = opponent_board & kHorizontalSandwichable;
+  const bitboard_type vertical_sandwichable_squares = opponent_board & kVerticalSandwichable;
+  const bitboard_type diagonal_sandwichable_squares = opponent_board & kDiagonalSandwichable;
 
   /* 空のマス全体。 */
-  const bitboard blank_squares = ~(my_board | opponent_board);
+  const bitboard_type blank_squares = ~(my_board | opponent_board) & kBoardMask;
 
-  bitboard tmp_board{};
-  bitboard result{};
+  bitboard_type tmp_board{};
+  bitboard_type result{};
 
   /* 左方向に置ける場所を探索。 */
   /* 自分のマスの左側に挟めるマスが連続して存在する限り、そこにbitを立てていく。
    */
   tmp_board = horizontal_sandwichable_squares & (my_board << 1);
-  for (int i = 0; i < 5; i++) {
+  for (int i = 0; i < kSandwichLoopCount; i++) {
     tmp_board |= horizontal_sandwichable_squares & (tmp_board << 1);
   }
   /* 空のマスと(挟めるマス全体とその1つ左のマス全体)の積をとることで、石を置けるマスを求めた。
@@ -298,99 +310,110 @@ bitboard OthelloState::legalBoard() const {
 
   /* 右方向。 */
   tmp_board = horizontal_sandwichable_squares & (my_board >> 1);
-  for (int i = 0; i < 5; i++) {
+  for (int i = 0; i < kSandwichLoopCount; i++) {
     tmp_board |= horizontal_sandwichable_squares & (tmp_board >> 1);
   }
   result |= blank_squares & (tmp_board >> 1);
 
   /* 上方向。 */
-  tmp_board = vertical_sandwichable_squares & (my_board << 8);
-  for (int i = 0; i < 5; i++) {
-    tmp_board |= vertical_sandwichable_squares & (tmp_board << 8);
+  tmp_board = vertical_sandwichable_squares & (my_board << kBoardSize);
+  for (int i = 0; i < kSandwichLoopCount; i++) {
+    tmp_board |= vertical_sandwichable_squares & (tmp_board << kBoardSize);
   }
-  result |= blank_squares & (tmp_board << 8);
+  result |= blank_squares & (tmp_board << kBoardSize);
 
   /* 下方向。 */
-  tmp_board = vertical_sandwichable_squares & (my_board >> 8);
-  for (int i = 0; i < 5; i++) {
-    tmp_board |= vertical_sandwichable_squares & (tmp_board >> 8);
+  tmp_board = vertical_sandwichable_squares & (my_board >> kBoardSize);
+  for (int i = 0; i < kSandwichLoopCount; i++) {
+    tmp_board |= vertical_sandwichable_squares & (tmp_board >> kBoardSize);
   }
-  result |= blank_squares & (tmp_board >> 8);
+  result |= blank_squares & (tmp_board >> kBoardSize);
 
   /* 右上方向。 */
-  tmp_board = diagonal_sandwichable_squares & (my_board << 7);
-  for (int i = 0; i < 5; i++) {
-    tmp_board |= diagonal_sandwichable_squares & (tmp_board << 7);
+  tmp_board = diagonal_sandwichable_squares & (my_board << (kBoardSize - 1));
+  for (int i = 0; i < kSandwichLoopCount; i++) {
+    tmp_board |= diagonal_sandwichable_squares & (tmp_board << (kBoardSize - 1));
   }
-  result |= blank_squares & (tmp_board << 7);
+  result |= blank_squares & (tmp_board << (kBoardSize - 1));
 
   /* 左上方向。 */
-  tmp_board = diagonal_sandwichable_squares & (my_board << 9);
-  for (int i = 0; i < 5; i++) {
-    tmp_board |= diagonal_sandwichable_squares & (tmp_board << 9);
+  tmp_board = diagonal_sandwichable_squares & (my_board << (kBoardSize + 1));
+  for (int i = 0; i < kSandwichLoopCount; i++) {
+    tmp_board |= diagonal_sandwichable_squares & (tmp_board << (kBoardSize + 1));
   }
-  result |= blank_squares & (tmp_board << 9);
+  result |= blank_squares & (tmp_board << (kBoardSize + 1));
 
   /* 右下方向。 */
-  tmp_board = diagonal_sandwichable_squares & (my_board >> 9);
-  for (int i = 0; i < 5; i++) {
-    tmp_board |= diagonal_sandwichable_squares & (tmp_board >> 9);
+  tmp_board = diagonal_sandwichable_squares & (my_board >> (kBoardSize + 1));
+  for (int i = 0; i < kSandwichLoopCount; i++) {
+    tmp_board |= diagonal_sandwichable_squares & (tmp_board >> (kBoardSize + 1));
   }
-  result |= blank_squares & (tmp_board >> 9);
+  result |= blank_squares & (tmp_board >> (kBoardSize + 1));
 
   /* 左下方向。 */
-  tmp_board = diagonal_sandwichable_squares & (my_board >> 7);
-  for (int i = 0; i < 5; i++) {
-    tmp_board |= diagonal_sandwichable_squares & (tmp_board >> 7);
+  tmp_board = diagonal_sandwichable_squares & (my_board >> (kBoardSize - 1));
+  for (int i = 0; i < kSandwichLoopCount; i++) {
+    tmp_board |= diagonal_sandwichable_squares & (tmp_board >> (kBoardSize - 1));
   }
-  result |= blank_squares & (tmp_board >> 7);
+  result |= blank_squares & (tmp_board >> (kBoardSize - 1));
 
   return result;
 }
 
-bitboard OthelloState::nextSquare(const bitboard square, const int direction) const {
+template <int kBoardSize>
+typename BasicOthelloState<kBoardSize>::bitboard_type BasicOthelloState<kBoardSize>::nextSquare(const bitboard_type square, const int direction) const {
   /* 8方向について、1つ先に移動できればその場所に1が立ったbit表現を返す。 */
   switch (direction) {
     case 0:  // 上。下には移動できないので、一番下はbitが立っていない。
-      return (square << 8) & 0xffffffffffffff00;
+      return (square << kBoardSize) & kNotBottomRow;
     case 1:  // 右上。
-      return (square << 7) & 0x7f7f7f7f7f7f7f00;
+      return (square << (kBoardSize - 1)) & kNotLeftColumn & kNotBottomRow;
     case 2:  // 右。
-      return (square >> 1) & 0x7f7f7f7f7f7f7f7f;
+      return (square >> 1) & kNotLeftColumn;
     case 3:  // 右下。
-      return (square >> 9) & 0x007f7f7f7f7f7f7f;
+      return (square >> (kBoardSize + 1)) & kNotLeftColumn & kNotTopRow;
     case 4:  // 下。
-      return (square >> 8) & 0x00ffffffffffffff;
+      return (square >> kBoardSize) & kNotTopRow;
     case 5:  // 左下。
-      return (square >> 7) & 0x00fefefefefefefe;
+      return (square >> (kBoardSize - 1)) & kNotRightColumn & kNotTopRow;
     case 6:  // 左。
-      return (square << 1) & 0xfefefefefefefefe;
+      return (square << 1) & kNotRightColumn;
     case 7:  // 左上。
-      return (square << 9) & 0xfefefefefefefe00;
+      return (square << (kBoardSize + 1)) & kNotRightColumn & kNotBottomRow;
     default:
       return 0;
   }
 }
 
-bool OthelloState::isPass() const {
+template <int kBoardSize>
+bool BasicOthelloState<kBoardSize>::isPass() const {
   /* 現在手番の合法手全体。 */
-  const bitboard my_legal_board{this->legalBoard()};
+  const bitboard_type my_legal_board{this->legalBoard()};
 
   /* 次手番の合法手全体。 */
-  OthelloState next_state{OthelloState(*this)};
-  next_state.cur_turn_ = (this->cur_turn_ == OthelloState::kBlackTurn) ? kWhiteTurn : kBlackTurn;
-  const bitboard opponent_legal_board{next_state.legalBoard()};
+  BasicOthelloState next_state{BasicOthelloState(*this)};
+  next_state.cur_turn_ = (this->cur_turn_ == BasicOthelloState::kBlackTurn) ? kWhiteTurn : kBlackTurn;
+  const bitboard_type opponent_legal_board{next_state.legalBoard()};
 
   /* 現在手番だけで合法手がなければ、パス。次手番でも合法手がなければ、終局。 */
-  return my_legal_board == (bitboard)0 && opponent_legal_board != (bitboard)0;
+  return my_legal_board == (bitboard_type)0 && opponent_legal_board != (bitboard_type)0;
 }
 
-std::ostream& operator<<(std::ostream& os, const OthelloState& src) {
+template <int kBoardSize>
+std::ostream& operator<<(std::ostream& os, const BasicOthelloState<kBoardSize>& src) {
   os << "## OthelloState" << std::endl;
   os << "# Table" << std::endl;
   os << src.board2String();
   os << "# 現在のプレイヤ" << std::endl;
-    os << ((src.cur_turn_ == OthelloState::kBlackTurn) ?
+    os << ((src.cur_turn_ == BasicOthelloState<kBoardSize>::kBlackTurn) ?
         "黒" : "白") << std::endl;
   return os;
 }
+
+template class BasicOthelloState<6>;
+template class BasicOthelloState<8>;
+template class BasicOthelloState<10>;
+
+template std::ostream& operator<<(std::ostream& os, const BasicOthelloState<6>& src);
+template std::ostream& operator<<(std::ostream& os, const BasicOthelloState<8>& src);
+template std::ostream& operator<<(std::ostream& os, const BasicOthelloState<10>& src);
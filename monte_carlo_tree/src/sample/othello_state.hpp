@@ -4,35 +4,108 @@
 #include <cassert>
 #include <array>
 #include <iostream>
+#include <type_traits>
 #include <vector>
 
 #include "othello_types.hpp"
 #include "othello_observation.hpp"
 
-class OthelloState {
+/* 盤の大きさからマスクを組み立てる関数。クラスの定数の初期化に使うので、クラスの外に置く。 */
+/* マスはA1, B1, ..., A2, ... の順に、最上位bitから並べる。 */
+template <int kBoardSize>
+constexpr sized_bitboard<kBoardSize> othelloSquareBit(const int x, const int y) {
+  return (sized_bitboard<kBoardSize>)1 << (kBoardSize * kBoardSize - 1 - (x + kBoardSize * y));
+}
+
+/* 盤上のマス全体。64マスの盤では全bitが立つ。 */
+template <int kBoardSize>
+constexpr sized_bitboard<kBoardSize> othelloBoardMask() {
+  using bitboard_type = sized_bitboard<kBoardSize>;
+  return (kBoardSize * kBoardSize == sizeof(bitboard_type) * 8) ? ~(bitboard_type)0 : ((bitboard_type)1 << (kBoardSize * kBoardSize)) - 1;
+}
+
+/* x列目(0がA列)のマス全体。 */
+template <int kBoardSize>
+constexpr sized_bitboard<kBoardSize> othelloColumnMask(const int x) {
+  sized_bitboard<kBoardSize> result{};
+  for (int y = 0; y < kBoardSize; y++) {
+    result |= othelloSquareBit<kBoardSize>(x, y);
+  }
+  return result;
+}
+
+/* y行目(0が1行目)のマス全体。 */
+template <int kBoardSize>
+constexpr sized_bitboard<kBoardSize> othelloRowMask(const int y) {
+  sized_bitboard<kBoardSize> result{};
+  for (int x = 0; x < kBoardSize; x++) {
+    result |= othelloSquareBit<kBoardSize>(x, y);
+  }
+  return result;
+}
+
+/* kBoardSize×kBoardSizeの盤のオセロ。盤の大きさに依存するマスクやシフト量、ループ回数はすべてコンパイル時に決まる。 */
+/* 64マス以下の盤は64bit、それより大きい盤は128bitで表現する。 */
+template <int kBoardSize>
+class BasicOthelloState {
  public:
+  static_assert(kBoardSize >= 4 && kBoardSize % 2 == 0 && kBoardSize * kBoardSize <= 128, "unsupported board size.");
+
+  using bitboard_type = sized_bitboard<kBoardSize>;
+
   static constexpr int kBlackTurn{0};
   static constexpr int kWhiteTurn{1};
+  static constexpr int kNumberOfSquares{kBoardSize * kBoardSize};
+  static constexpr int kNumberOfActionIndices{kNumberOfSquares}; // 着手はマスで表せる。パスは着手にならない。
 
   /* ゲーム初期化用。 */
-  OthelloState() = default;
+  BasicOthelloState() = default;
 
   /* OthelloObservationから組み立てる用。 */
-  OthelloState(const bitboard& black_board, const bitboard& white_board, const int cur_turn)
+  BasicOthelloState(const bitboard_type& black_board, const bitboard_type& white_board, const int cur_turn)
       : black_board_(black_board), white_board_(white_board), cur_turn_(cur_turn) {}
 
+  /* apply()で変えた状態をundo()で戻すための情報。 */
+  struct UndoInfo {
+    bitboard_type reversed_squares; // 反転した石。
+    int cur_turn;                   // 手を打ったプレイヤ。
+  };
+
   /* 受け取った手を適用して得られる状態を返す。 */
-  OthelloState next(const coord& action) const;
+  BasicOthelloState next(const coord& action) const;
+
+  /* 添字で表した手を適用して得られる状態を返す。 */
+  BasicOthelloState next(const square_index action) const;
+
+  /* 受け取った手をこの状態に適用する。返り値をundo()に渡すと元に戻る。 */
+  UndoInfo apply(const coord& action) { return this->applyBit(coord2Bit(action)); }
+
+  UndoInfo apply(const square_index action) { return this->applyBit(squareBit(action)); }
+
+  /* apply(action)で返されたinfoを使って、手を打つ前の状態に戻す。 */
+  void undo(const coord& action, const UndoInfo& info) { this->undoBit(coord2Bit(action), info); }
+
+  void undo(const square_index action, const UndoInfo& info) { this->undoBit(squareBit(action), info); }
 
   /* 合法手の全体を返す。 */
   std::vector<coord> legalActions() const;
 
+  /* 合法手の全体を、legalActions()と同じ順でactionsに書き出す。MonteCarloTreeNodeなどでsquare_indexを行動の型にするときに使われる。 */
+  void legalActions(std::vector<square_index>& actions) const;
+
+  /* 合法手の数。 */
+  int countLegalActions() const { return count(this->legalBoard()); }
+
   /* ゲームが終了しているか？ */
   bool isFinished() const;
 
-  /* 合法手か(外向け)。 */
+  /* 合法手か(外向け)。盤外の座標ならfalse。 */
   bool isLegal(const coord put) const {
-    return this->isLegal(coord2Bit(put));
+    return 0 <= put.first && put.first < kBoardSize && 0 <= put.second && put.second < kBoardSize && this->isLegal(coord2Bit(put));
+  }
+
+  bool isLegal(const square_index put) const {
+    return put < kNumberOfSquares && this->isLegal(squareBit(put));
   }
 
   /* 座標をbit表現に変換。 */
@@ -44,22 +117,60 @@ class OthelloState {
 
   int countDisksOf(int player_num) const {
     switch (player_num) {
-      case OthelloState::kBlackTurn:
+      case BasicOthelloState::kBlackTurn:
         return this->count(this->black_board_);
-      case OthelloState::kWhiteTurn:
+      case BasicOthelloState::kWhiteTurn:
         return this->count(this->white_board_);
       default:
         return 0;
     }
   }
 
-  OthelloObservation getObservation() const {
-    return OthelloObservation{
-      this->black_board_,
-      this->white_board_,
-      this->cur_turn_,
-      this->legalActions()
-    };
+  bitboard_type getBlackBoard() const { return this->black_board_; }
+
+  bitboard_type getWhiteBoard() const { return this->white_board_; }
+
+  /* 盤面に対称変換を施した状態を返す。symmetryは0〜7。 */
+  BasicOthelloState transform(const int symmetry) const {
+    return BasicOthelloState(transformBoard(this->black_board_, symmetry), transformBoard(this->white_board_, symmetry), this->cur_turn_);
+  }
+
+  /* 8通りの対称変換のうち、(黒, 白)の盤面が辞書順で最小になるものを返す。 */
+  int canonicalSymmetry() const;
+
+  /* 恒等変換以外の対称変換で、盤面が変わらないか。 */
+  bool isSymmetric() const;
+
+  /* 対称な局面を同一視したときの代表の局面。 */
+  BasicOthelloState canonical() const { return this->transform(this->canonicalSymmetry()); }
+
+  /* 黒の盤面, 白の盤面(それぞれ下位64bit, 上位64bit), 手番。 */
+  std::array<uint64_t, 6> positionKey() const {
+    const auto high{[](const bitboard_type board) -> uint64_t {
+      if constexpr (sizeof(bitboard_type) > sizeof(uint64_t)) {
+        return (uint64_t)(board >> 64);
+      } else {
+        return 0;
+      }
+    }};
+    return {(uint64_t)this->black_board_, high(this->black_board_), (uint64_t)this->white_board_, high(this->white_board_),
+            (uint64_t)this->cur_turn_, 0};
+  }
+
+  bool operator==(const BasicOthelloState& other) const {
+    return this->black_board_ == other.black_board_ && this->white_board_ == other.white_board_ && this->cur_turn_ == other.cur_turn_;
+  }
+
+  /* GameActionは合法手の型。coordかsquare_index。 */
+  template <typename GameAction = coord>
+  BasicOthelloObservation<bitboard_type, GameAction> getObservation() const {
+    BasicOthelloObservation<bitboard_type, GameAction> result{this->black_board_, this->white_board_, this->cur_turn_, {}};
+    if constexpr (std::is_same_v<GameAction, coord>) {
+      result.legal_actions_ = this->legalActions();
+    } else {
+      this->legalActions(result.legal_actions_);
+    }
+    return result;
   }
 
   /* 盤面を文字列に変換。 */
@@ -68,8 +179,43 @@ class OthelloState {
   /* 盤面を出力。 */
   void print() const { std::cout << board2String(); }
 
-  static bitboard coord2Bit(const coord xy) {
-    return OthelloState::kSquare.at(xy.first + 8 * xy.second);
+  static constexpr bitboard_type coord2Bit(const coord xy) {
+    return othelloSquareBit<kBoardSize>(xy.first, xy.second);
+  }
+
+  /* 添字のマスのbit表現。シフト1回で求まる。 */
+  static constexpr bitboard_type squareBit(const square_index index) {
+    return (bitboard_type)1 << (kNumberOfSquares - 1 - index);
+  }
+
+  /* 着手の添字。A1, B1, ..., A2, ... の順。 */
+  static constexpr int actionIndex(const coord& xy) { return xy.first + kBoardSize * xy.second; }
+
+  static constexpr int actionIndex(const square_index index) { return index; }
+
+  static constexpr square_index coord2Square(const coord& xy) { return (square_index)actionIndex(xy); }
+
+  /* kPassSquareは{-1, -1}にする。 */
+  static constexpr coord square2Coord(const square_index index) {
+    return (index == kPassSquare) ? coord(-1, -1) : coord(index % kBoardSize, index / kBoardSize);
+  }
+
+  /* 石が1つだけ立ったbit表現を座標に変換。 */
+  static coord bit2Coord(const bitboard_type put) {
+    const int square{kNumberOfSquares - 1 - countTrailingZeros(put)};
+    return coord(square % kBoardSize, square / kBoardSize);
+  }
+
+  /* 盤面の対称変換。symmetryのbit2が立っていれば最初にA1からの対角線で転置し、続けてbit0で左右反転、bit1で上下反転する。 */
+  static bitboard_type transformBoard(bitboard_type board, const int symmetry);
+
+  static coord transformCoord(const coord xy, const int symmetry) {
+    return bit2Coord(transformBoard(coord2Bit(xy), symmetry));
+  }
+
+  /* 逆変換。転置を含む変換では、左右反転と上下反転が入れ替わる。 */
+  static int inverseSymmetry(const int symmetry) {
+    return (symmetry & 4) ? (4 | ((symmetry & 1) << 1) | ((symmetry & 2) >> 1)) : symmetry;
   }
 
   static coord str2Coord(std::string str);
@@ -77,30 +223,56 @@ class OthelloState {
   static std::string coord2Str(coord c);
 
  private:
-  /* マスの表現。A1, B1, ..., H1, A2, ..., H8 の順。 */
-  static const std::array<bitboard, 64> kSquare;
+  static constexpr bitboard_type kBoardMask{othelloBoardMask<kBoardSize>()};
+  static constexpr bitboard_type kNotLeftColumn{kBoardMask & ~othelloColumnMask<kBoardSize>(0)};
+  static constexpr bitboard_type kNotRightColumn{kBoardMask & ~othelloColumnMask<kBoardSize>(kBoardSize - 1)};
+  static constexpr bitboard_type kNotTopRow{kBoardMask & ~othelloRowMask<kBoardSize>(0)};
+  static constexpr bitboard_type kNotBottomRow{kBoardMask & ~othelloRowMask<kBoardSize>(kBoardSize - 1)};
 
-  bitboard black_board_{0x00'00'00'08'10'00'00'00};
-  bitboard white_board_{0x00'00'00'10'08'00'00'00};
-  int cur_turn_{OthelloState::kBlackTurn};
+  /* 左右方向・上下方向・斜め方向にそれぞれ挟めるマス全体。端は挟めない。8×8なら0x7e7e7e7e7e7e7e7e, 0x00FFFFFFFFFFFF00, 0x007e7e7e7e7e7e00。 */
+  static constexpr bitboard_type kHorizontalSandwichable{kNotLeftColumn & kNotRightColumn};
+  static constexpr bitboard_type kVerticalSandwichable{kNotTopRow & kNotBottomRow};
+  static constexpr bitboard_type kDiagonalSandwichable{kHorizontalSandwichable & kVerticalSandwichable};
+
+  /* 端から端まで挟める石の数はkBoardSize - 2個なので、最初の1個に続けて広げる回数。 */
+  static constexpr int kSandwichLoopCount{kBoardSize - 3};
+
+  /* 初期配置。中央の4マスに、黒は右上と左下、白は左上と右下。 */
+  static constexpr bitboard_type kInitialBlackBoard{
+      othelloSquareBit<kBoardSize>(kBoardSize / 2, kBoardSize / 2 - 1) | othelloSquareBit<kBoardSize>(kBoardSize / 2 - 1, kBoardSize / 2)};
+  static constexpr bitboard_type kInitialWhiteBoard{
+      othelloSquareBit<kBoardSize>(kBoardSize / 2 - 1, kBoardSize / 2 - 1) | othelloSquareBit<kBoardSize>(kBoardSize / 2, kBoardSize / 2)};
+
+  bitboard_type black_board_{kInitialBlackBoard};
+  bitboard_type white_board_{kInitialWhiteBoard};
+  int cur_turn_{BasicOthelloState::kBlackTurn};
 
   /* 合法手か。 */
-  bool isLegal(const bitboard put) const {
+  bool isLegal(const bitboard_type put) const {
     return (put & this->legalBoard()) == put;
   }
 
+  /* putに置く。 */
+  UndoInfo applyBit(const bitboard_type put);
+
+  /* putに置いたのを戻す。 */
+  void undoBit(const bitboard_type put, const UndoInfo& info);
+
+  /* putに置いたときに反転する石。 */
+  bitboard_type reversedSquares(const bitboard_type put) const;
+
   /* 置ける場所の一覧をbit表現で返す。 */
-  bitboard legalBoard() const;
+  bitboard_type legalBoard() const;
 
   /* squareをdirectionの向きに移す。 */
-  bitboard nextSquare(const bitboard square, int direction) const;
+  bitboard_type nextSquare(const bitboard_type square, int direction) const;
 
   /* パスかどうか。 */
   bool isPass() const;
 
   /* bitboardの1を数える。 */
-  static int count(const bitboard src) {
-    bitboard tmp{src};
+  static int count(const uint64_t src) {
+    uint64_t tmp{src};
     tmp = (tmp & 0x5555555555555555) + (tmp >> 1 & 0x5555555555555555);   // 2bits区切でビット数を数える。
     tmp = (tmp & 0x3333333333333333) + (tmp >> 2 & 0x3333333333333333);   // 4bits区切。
     tmp = (tmp & 0x0f0f0f0f0f0f0f0f) + (tmp >> 4 & 0x0f0f0f0f0f0f0f0f);   // 8bits。
@@ -109,8 +281,32 @@ class OthelloState {
     return (tmp & 0x00000000ffffffff) + (tmp >> 32 & 0x00000000ffffffff); // 64bits。
   }
 
+  /* 128bitの盤は上位と下位に分けて数える。 */
+  static int count(const unsigned __int128 src) {
+    return count((uint64_t)src) + count((uint64_t)(src >> 64));
+  }
+
+  static int countTrailingZeros(const uint64_t src) { return __builtin_ctzll(src); }
+
+  static int countTrailingZeros(const unsigned __int128 src) {
+    return ((uint64_t)src != 0) ? __builtin_ctzll((uint64_t)src) : 64 + __builtin_ctzll((uint64_t)(src >> 64));
+  }
+
   /* デバッグ用。状態クラスの出力。 */
-  friend std::ostream& operator<<(std::ostream& os, const OthelloState& src);
+  template <int kSize>
+  friend std::ostream& operator<<(std::ostream& os, const BasicOthelloState<kSize>& src);
 };
 
+template <int kBoardSize>
+std::ostream& operator<<(std::ostream& os, const BasicOthelloState<kBoardSize>& src);
+
+/* 実体化するのは、othello_state.cppで明示的に実体化したものだけ。 */
+extern template class BasicOthelloState<6>;
+extern template class BasicOthelloState<8>;
+extern template class BasicOthelloState<10>;
+
+using OthelloState = BasicOthelloState<8>;
+using OthelloState6x6 = BasicOthelloState<6>;
+using OthelloState10x10 = BasicOthelloState<10>;
+
 #endif  // OTHELLO_STATE_HPP_
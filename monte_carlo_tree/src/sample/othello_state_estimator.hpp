@@ -4,10 +4,12 @@
 #include "othello_observation.hpp"
 #include "othello_state.hpp"
 
-class OthelloStateEstimator {
+template <int kBoardSize>
+class BasicOthelloStateEstimator {
  public:
-  OthelloState estimate(const OthelloObservation& observation) {
-    return OthelloState(
+  template <typename GameAction>
+  BasicOthelloState<kBoardSize> estimate(const BasicOthelloObservation<sized_bitboard<kBoardSize>, GameAction>& observation) {
+    return BasicOthelloState<kBoardSize>(
       observation.black_board_,
       observation.white_board_,
       observation.cur_turn_
@@ -15,4 +17,6 @@ class OthelloStateEstimator {
   }
 };
 
+using OthelloStateEstimator = BasicOthelloStateEstimator<8>;
+
 #endif // OTHELLO_STATE_ESTIMATOR_
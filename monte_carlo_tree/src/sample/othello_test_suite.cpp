@@ -0,0 +1,234 @@
+#include "othello_test_suite.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#include "../monte_carlo_tree_node.hpp"
+#include "../primitive_monte_carlo_root.hpp"
+#include "othello_observation.hpp"
+#include "othello_solver.hpp"
+#include "othello_state_estimator.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kCheckInterval{64}; // 何回探索するごとに最善手を確かめるか。
+
+bool parseBoard(const std::string& str, bitboard& board) {
+  if (str.size() != 16 || str.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) { return false; }
+  board = std::stoull(str, nullptr, 16);
+  return true;
+}
+
+bool isBestAction(const OthelloTestPosition& position, const coord& action) {
+  return std::find(position.best_actions.begin(), position.best_actions.end(), action) != position.best_actions.end();
+}
+
+double secondsSince(const Clock::time_point start_time) {
+  return std::chrono::duration<double>(Clock::now() - start_time).count();
+}
+
+/* search_steps(回数)で探索を進めながら、kCheckInterval回ごとに最善手を確かめる。 */
+/* 時間か回数を使い切るか、探索の必要がなくなったら終える。 */
+template <class SearchSteps, class BestAction>
+void searchWithinBudget(const OthelloTestPosition& position, const TestSuiteSettings& settings,
+                        SearchSteps search_steps, BestAction best_action, TestSuiteResult& result) {
+  const Clock::time_point start_time{Clock::now()};
+  const Clock::time_point deadline{start_time + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(settings.seconds))};
+  result.is_graded = !position.best_actions.empty();
+
+  long long iteration_cnt{};
+  while (true) {
+    const int step_cnt{(int)std::min<long long>(kCheckInterval, settings.playout_limit - iteration_cnt)};
+    const int play_cnt{(step_cnt > 0) ? search_steps(step_cnt) : 0};
+    iteration_cnt += play_cnt;
+
+    result.action = best_action();
+    if (!isBestAction(position, result.action)) {
+      result.is_solved = false;
+    } else if (!result.is_solved) {
+      result.is_solved = true;
+      result.seconds_to_solution = secondsSince(start_time);
+      result.iterations_to_solution = iteration_cnt;
+    }
+
+    if (play_cnt <= 0 || iteration_cnt >= settings.playout_limit || Clock::now() >= deadline) { break; }
+  }
+  result.seconds = secondsSince(start_time);
+  result.iteration_cnt = iteration_cnt;
+}
+
+TestSuiteResult runPosition(const OthelloTestPosition& position, const TestSuiteSettings& settings, const unsigned int seed) {
+  TestSuiteResult result{};
+  const OthelloState& state{position.state};
+
+  switch (settings.method) {
+    case TestSuiteMethod::kMonteCarloTree: {
+      MonteCarloTreeNode<OthelloState, coord, 2> node{(settings.rollout_policy == nullptr)
+          ? MonteCarloTreeNode<OthelloState, coord, 2>(state, state.getCurrentPlayerNum(), {-1, -1}, seed)
+          : MonteCarloTreeNode<OthelloState, coord, 2>(state, state.getCurrentPlayerNum(), {-1, -1}, seed, 0.0,
+                                                       OthelloRolloutPolicy::asPlayoutPolicy(settings.rollout_policy))};
+      if (settings.pattern_evaluator != nullptr) {
+        node.setTruncatedPlayout(settings.truncated_playout_depth, OthelloPatternEvaluator::asPlayoutEvaluator(settings.pattern_evaluator));
+      }
+      searchWithinBudget(position, settings, [&node](const int n) { return node.searchSteps(n); },
+                         [&node]() { return node.getBestAction(); }, result);
+      break;
+    }
+    case TestSuiteMethod::kPrimitiveMonteCarlo: {
+      OthelloStateEstimator estimator{};
+      PrimitiveMonteCarloRoot<OthelloState, OthelloObservation, OthelloStateEstimator, coord, 2> node(
+          state.getObservation(), estimator, state.getCurrentPlayerNum());
+      std::function<coord(const OthelloState&, XorShift64&)> playout_policy{};
+      if (settings.rollout_policy != nullptr) {
+        playout_policy = OthelloRolloutPolicy::asPlayoutPolicy(settings.rollout_policy);
+      }
+      searchWithinBudget(position, settings,
+                         [&node, &playout_policy](const int n) { return playout_policy ? node.searchSteps(n, playout_policy) : node.searchSteps(n); },
+                         [&node]() { return node.getBestAction(); }, result);
+      break;
+    }
+    case TestSuiteMethod::kSolver: {
+      const Clock::time_point start_time{Clock::now()};
+      OthelloEndgameSolver solver{};
+      const bool is_finished{solver.solve(state, start_time + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(settings.seconds)),
+                                          result.action, result.score)};
+      result.seconds = secondsSince(start_time);
+      result.iteration_cnt = solver.getNodeCount();
+      result.is_graded = true;
+      result.is_solved = is_finished && (position.best_actions.empty() || isBestAction(position, result.action)) &&
+                         (!position.has_score || result.score == position.score);
+      if (result.is_solved) {
+        result.seconds_to_solution = result.seconds;
+        result.iterations_to_solution = result.iteration_cnt;
+      }
+      break;
+    }
+  }
+  return result;
+}
+
+} // namespace
+
+bool loadTestPositions(const std::string& path, std::vector<OthelloTestPosition>& positions) {
+  std::ifstream ifs(path);
+  if (!ifs) { return false; }
+
+  std::vector<OthelloTestPosition> result{};
+  std::string line{};
+  while (std::getline(ifs, line)) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream iss(line);
+    std::string black{};
+    if (!(iss >> black)) { continue; }
+
+    std::string white{};
+    std::string turn{};
+    std::string actions{};
+    bitboard black_board{};
+    bitboard white_board{};
+    if (!(iss >> white >> turn >> actions) || !parseBoard(black, black_board) || !parseBoard(white, white_board) ||
+        (black_board & white_board) != 0 || (turn != "black" && turn != "white")) {
+      return false;
+    }
+
+    OthelloTestPosition position{};
+    position.state = OthelloState(black_board, white_board, (turn == "black") ? OthelloState::kBlackTurn : OthelloState::kWhiteTurn);
+    if (position.state.countLegalActions() <= 0) { return false; }
+
+    if (actions != "-") {
+      std::istringstream actions_stream(actions);
+      std::string action_str{};
+      while (std::getline(actions_stream, action_str, ',')) {
+        const coord action{OthelloState::str2Coord(action_str)};
+        if (action == coord(-1, -1) || !position.state.isLegal(action)) { return false; }
+        position.best_actions.push_back(action);
+      }
+    }
+
+    position.has_score = static_cast<bool>(iss >> position.score);
+    if (position.best_actions.empty() && !position.has_score) { return false; }
+    result.push_back(std::move(position));
+  }
+
+  positions = std::move(result);
+  return true;
+}
+
+bool parseTestSuiteMethod(const std::string& name, TestSuiteMethod& method) {
+  if (name == "mcts") {
+    method = TestSuiteMethod::kMonteCarloTree;
+  } else if (name == "pmc") {
+    method = TestSuiteMethod::kPrimitiveMonteCarlo;
+  } else if (name == "solve") {
+    method = TestSuiteMethod::kSolver;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+std::vector<TestSuiteResult> runTestSuite(const std::vector<OthelloTestPosition>& positions, const TestSuiteSettings& settings,
+                                          std::ostream& log) {
+  std::vector<TestSuiteResult> results(positions.size());
+
+  /* 局面ごとに独立な探索なので、空いたスレッドが次の局面を取っていく。 */
+  std::atomic<std::size_t> next_index{0};
+  std::vector<std::thread> workers{};
+  for (int t = 0; t < std::max(settings.num_threads, 1); t++) {
+    workers.emplace_back([&]() {
+      for (std::size_t i = next_index++; i < positions.size(); i = next_index++) {
+        results.at(i) = runPosition(positions.at(i), settings, settings.seed + i);
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+
+  log << "    #  action  score  solved  seconds_to_solution  iterations_to_solution  seconds  iterations" << std::endl;
+  int graded_cnt{};
+  int solved_cnt{};
+  double sum_seconds_to_solution{};
+  double sum_iterations_to_solution{};
+  for (std::size_t i = 0; i < results.size(); i++) {
+    const TestSuiteResult& result{results.at(i)};
+    log << std::setw(5) << i + 1
+        << std::setw(8) << OthelloState::coord2Str(result.action)
+        << std::setw(7);
+    if (settings.method == TestSuiteMethod::kSolver) {
+      log << result.score;
+    } else {
+      log << "-";
+    }
+    log << std::setw(8) << (!result.is_graded ? "-" : (result.is_solved ? "yes" : "no"))
+        << std::setw(21) << std::fixed << std::setprecision(4);
+    if (result.is_solved) {
+      log << result.seconds_to_solution << std::setw(24) << result.iterations_to_solution;
+    } else {
+      log << "-" << std::setw(24) << "-";
+    }
+    log << std::setw(9) << result.seconds << std::setw(12) << result.iteration_cnt << std::endl;
+
+    if (!result.is_graded) { continue; }
+    graded_cnt++;
+    if (result.is_solved) {
+      solved_cnt++;
+      sum_seconds_to_solution += result.seconds_to_solution;
+      sum_iterations_to_solution += result.iterations_to_solution;
+    }
+  }
+
+  log << "solved " << solved_cnt << "/" << graded_cnt
+      << " (" << std::setprecision(3) << (double)solved_cnt / std::max(graded_cnt, 1) << ")"
+      << ", mean seconds_to_solution " << std::setprecision(4) << sum_seconds_to_solution / std::max(solved_cnt, 1)
+      << ", mean iterations_to_solution " << std::setprecision(0) << sum_iterations_to_solution / std::max(solved_cnt, 1) << std::endl;
+  return results;
+}
@@ -0,0 +1,68 @@
+#ifndef OTHELLO_TEST_SUITE_HPP_
+#define OTHELLO_TEST_SUITE_HPP_
+
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "othello_pattern_evaluator.hpp"
+#include "othello_rollout_policy.hpp"
+#include "othello_state.hpp"
+#include "othello_types.hpp"
+
+/* 局面集のファイルの形式。1行に1局面で、#から行末まではコメント。 */
+/* <黒の盤面> <白の盤面> <black|white> <最善手> [石差] */
+/* 盤面はA1を最上位bitとする16桁の16進数。最善手はd3のように書き、複数あれば","で区切る。調べないなら"-"。 */
+/* 石差は読み切りで求めた、手番のプレイヤから見た終局時の石差(OthelloEndgameSolverと同じ)。 */
+struct OthelloTestPosition {
+  OthelloState state;
+  std::vector<coord> best_actions; // 空なら最善手は調べない。
+  bool has_score;
+  int score;
+};
+
+/* 局面集を読み込む。形式が合わない行や、合法手のない局面があればfalseを返す。 */
+bool loadTestPositions(const std::string& path, std::vector<OthelloTestPosition>& positions);
+
+enum class TestSuiteMethod {
+  kMonteCarloTree,     // MonteCarloTreeNode
+  kPrimitiveMonteCarlo, // PrimitiveMonteCarloRoot
+  kSolver              // OthelloEndgameSolver
+};
+
+/* "mcts", "pmc", "solve"のいずれかをmethodに変換する。 */
+bool parseTestSuiteMethod(const std::string& name, TestSuiteMethod& method);
+
+/* 局面集の実行の設定。 */
+struct TestSuiteSettings {
+  TestSuiteMethod method{TestSuiteMethod::kMonteCarloTree};
+  double seconds{1.0};                                // 1局面あたりの時間。
+  int playout_limit{std::numeric_limits<int>::max()}; // 1局面あたりのプレイアウト回数。読み切りでは使わない。
+  int num_threads{1};
+  unsigned int seed{1};
+  std::shared_ptr<const OthelloRolloutPolicy> rollout_policy{};       // あればプレイアウトに使う。
+  std::shared_ptr<const OthelloPatternEvaluator> pattern_evaluator{}; // あればMonteCarloTreeNodeのプレイアウトを打ち切る。
+  int truncated_playout_depth{4};
+};
+
+/* 1局面の結果。 */
+struct TestSuiteResult {
+  coord action;                     // 最後に選んだ手。
+  int score;                        // 読み切りで求めた石差。
+  bool is_graded;                   // 正解と比べられたか。最善手のない局面は、読み切り以外では比べられない。
+  bool is_solved;                   // 最後に選んだ手(読み切りでは石差も)が正解だったか。
+  double seconds;                   // 探索にかかった時間。
+  long long iteration_cnt;          // プレイアウト回数。読み切りでは調べた局面の数。
+  double seconds_to_solution;       // 正解の手を選び、最後まで変えなくなった時点。読み切りでは読み切った時点。
+  long long iterations_to_solution;
+};
+
+/* 各局面をsettingsの方法で探索し、正解にたどり着くまでの時間と回数を調べる。 */
+/* 局面はnum_threads個のスレッドで分けて探索する。時間は経過時間なので、コア数よりスレッドが多いと長くなる。 */
+/* 局面ごとの結果と、解けた割合、解けた局面での平均をlogへ出力する。 */
+std::vector<TestSuiteResult> runTestSuite(const std::vector<OthelloTestPosition>& positions, const TestSuiteSettings& settings,
+                                          std::ostream& log);
+
+#endif // OTHELLO_TEST_SUITE_HPP_
@@ -2,9 +2,18 @@
 #define OTHELLO_TYPES_HPP_
 
 #include <stdint.h>
+#include <type_traits>
 #include <utility>
 
 using bitboard = uint64_t;
 using coord = std::pair<int, int>;  // A4は{0, 3} で表現。
 
+/* マスの添字で表した着手。A1, B1, ..., A2, ... の順。coordより小さく、節点に持たせたり比べたりするのが安い。 */
+using square_index = uint8_t;
+constexpr square_index kPassSquare{0xff}; // 着手がないことを表す値。パスは状態の側で済ませるので、根の直前の手などに使う。
+
+/* kBoardSize×kBoardSizeの盤のbit表現。64マス以下なら64bit、それより大きければ128bit。 */
+template <int kBoardSize>
+using sized_bitboard = std::conditional_t<(kBoardSize * kBoardSize <= 64), uint64_t, unsigned __int128>;
+
 #endif // OTHELLO_TYPES_HPP_
@@ -0,0 +1,124 @@
+#ifndef SEARCH_CONTROL_HPP_
+#define SEARCH_CONTROL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+
+/* 探索の外側から停止を伝えるための型。 */
+/* SearchStopSourceで停止を要求すると、そこから作ったSearchStopTokenを持つ探索はすべて探索1回分以内に止まる。 */
+class SearchStopToken {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /* 停止を要求されることのないトークン。 */
+  SearchStopToken() = default;
+
+  SearchStopToken(std::shared_ptr<const std::atomic<bool>> is_stopped, const Clock::time_point deadline)
+      : is_stopped_(std::move(is_stopped)), deadline_(deadline) {}
+
+  /* 同じ停止要求に、さらに期限を加えたトークン。 */
+  SearchStopToken withDeadline(const Clock::time_point deadline) const {
+    return SearchStopToken(this->is_stopped_, std::min(this->deadline_, deadline));
+  }
+
+  Clock::time_point getDeadline() const { return this->deadline_; }
+
+  /* 期限までの残り時間(秒)。期限がなければ無限大。 */
+  double remainingSeconds() const {
+    if (this->deadline_ == Clock::time_point::max()) { return std::numeric_limits<double>::infinity(); }
+    return std::max(std::chrono::duration<double>(this->deadline_ - Clock::now()).count(), 0.0);
+  }
+
+  bool isStopRequested() const {
+    if (this->is_stopped_ != nullptr && this->is_stopped_->load(std::memory_order_relaxed)) { return true; }
+    return this->deadline_ != Clock::time_point::max() && Clock::now() >= this->deadline_;
+  }
+
+ private:
+  std::shared_ptr<const std::atomic<bool>> is_stopped_{};
+  Clock::time_point deadline_{Clock::time_point::max()};
+};
+
+class SearchStopSource {
+ public:
+  SearchStopToken token() const { return SearchStopToken(this->is_stopped_, SearchStopToken::Clock::time_point::max()); }
+
+  void requestStop() { this->is_stopped_->store(true, std::memory_order_relaxed); }
+
+  bool isStopRequested() const { return this->is_stopped_->load(std::memory_order_relaxed); }
+
+ private:
+  std::shared_ptr<std::atomic<bool>> is_stopped_{std::make_shared<std::atomic<bool>>(false)};
+};
+
+/* 探索を予定より早く打ち切る条件。得点は0〜1に正規化されている前提。 */
+enum class EarlyStopRule {
+  kNone,        // 打ち切らない。
+  kBudget,      // 残りのプレイアウトをどう配っても、平均得点が最も高い手が入れ替わらなくなったら打ち切る。
+  kConfidence,  // kBudgetに加えて、最善手の平均得点の信頼下限が、他のすべての手の信頼上限を上回ったら打ち切る。
+};
+
+/* 子節点childrenの統計から、player_num目線で平均得点が最も高い手がもう決まったかを判定する。 */
+/* remaining_play_cntは残りのプレイアウト回数、zは信頼区間の幅(標準誤差の何倍か)。 */
+/* 子節点は getPlayCount(), getSumScores(), getSumScoresSquared() を持つ型。 */
+template <class Children>
+bool isDecisionSettled(const Children& children, const int player_num, const double remaining_play_cnt,
+                       const EarlyStopRule rule, const double z) {
+  constexpr double kMinVariance{0.01}; // 探索回数が少なく結果がそろっただけの手を、確実と見なさないための分散の下限。
+
+  if (rule == EarlyStopRule::kNone || children.size() < 2) { return false; }
+  for (const auto& child : children) {
+    if (child.getPlayCount() <= 0) { return false; }
+  }
+
+  const auto mean{[player_num](const auto& child) { return child.getSumScores().at(player_num) / child.getPlayCount(); }};
+  const auto best{std::max_element(children.begin(), children.end(),
+      [&mean](const auto& a, const auto& b) { return mean(a) < mean(b); })};
+
+  /* 残りをすべて最善手に0点で回しても、すべて他の手に1点で回しても、順位が変わらないか。 */
+  const double best_lower_bound{best->getSumScores().at(player_num) / (best->getPlayCount() + remaining_play_cnt)};
+  bool is_settled{true};
+  for (auto child = children.begin(); child != children.end(); ++child) {
+    if (child == best) { continue; }
+    const double upper_bound{(child->getSumScores().at(player_num) + remaining_play_cnt) / (child->getPlayCount() + remaining_play_cnt)};
+    if (upper_bound >= best_lower_bound) {
+      is_settled = false;
+      break;
+    }
+  }
+  if (is_settled || rule != EarlyStopRule::kConfidence) { return is_settled; }
+
+  /* 平均得点 ± z × 標準誤差 で比べる。分散はsum_scores_squaredから求める。 */
+  const auto half_width{[player_num, z, &mean, kMinVariance](const auto& child) {
+    const double variance{child.getSumScoresSquared().at(player_num) / child.getPlayCount() - mean(child) * mean(child)};
+    return z * std::sqrt(std::max(variance, kMinVariance) / child.getPlayCount());
+  }};
+  const double best_confidence_lower_bound{mean(*best) - half_width(*best)};
+  for (auto child = children.begin(); child != children.end(); ++child) {
+    if (child == best) { continue; }
+    if (mean(*child) + half_width(*child) >= best_confidence_lower_bound) { return false; }
+  }
+  return true;
+}
+
+/* 探索途中の状況。 */
+template <typename GameAction>
+struct SearchProgress {
+  GameAction best_action;    // 現時点で最も平均得点の高い行動。
+  int best_play_cnt;         // best_actionを探索した回数。
+  double mean_score;         // best_actionの平均得点。
+  int whole_play_cnt;        // 根の探索回数の合計。
+  double elapsed_seconds;    // 今回の探索を始めてからの経過時間。
+  double playouts_per_second;
+};
+
+/* 探索を行っているスレッドから呼ばれる。 */
+template <typename GameAction>
+using SearchProgressCallback = std::function<void(const SearchProgress<GameAction>&)>;
+
+#endif // SEARCH_CONTROL_HPP_
@@ -0,0 +1,78 @@
+#ifndef SEARCH_EXECUTOR_HPP_
+#define SEARCH_EXECUTOR_HPP_
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "worker_placement.hpp"
+
+/* 探索を実行する固定数のスレッド。searchAsync()に渡し、多数の探索要求で同じスレッドを使い回す。 */
+/* 要求は受け付けた順に、空いたスレッドが1つずつ最後まで探索する。スレッドより要求が多ければ、空くまで待つ。 */
+/* 締め切りごとに探索を細切れにして進めたいなら、MonteCarloSearchSchedulerを使う。 */
+class SearchExecutor {
+ public:
+  explicit SearchExecutor(const int num_threads = std::thread::hardware_concurrency(),
+                          const WorkerPoolSettings& settings = WorkerPoolSettings()) {
+    for (int i = 0; i < std::max(num_threads, 1); i++) {
+      this->workers_.emplace_back([this, i, settings]() {
+        const WorkerThreadScope worker_scope(settings, i);
+        this->work();
+      });
+    }
+  }
+
+  SearchExecutor(const SearchExecutor&) = delete;
+  SearchExecutor& operator=(const SearchExecutor&) = delete;
+
+  /* 受け付けた要求をすべて実行してから、スレッドを止める。 */
+  ~SearchExecutor() {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      this->is_stopping_ = true;
+    }
+    this->condition_.notify_all();
+    for (std::thread& worker : this->workers_) {
+      worker.join();
+    }
+  }
+
+  /* taskをいずれかのスレッドで実行する。 */
+  void post(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      this->tasks_.push_back(std::move(task));
+    }
+    this->condition_.notify_one();
+  }
+
+  int getThreadCount() const { return this->workers_.size(); }
+
+ private:
+  std::vector<std::thread> workers_{};
+  std::mutex mutex_{};
+  std::condition_variable condition_{};
+  std::deque<std::function<void()>> tasks_{};
+  bool is_stopping_{false}; // 変えるときはmutex_を取る。
+
+  void work() {
+    while (true) {
+      std::function<void()> task{};
+      {
+        std::unique_lock<std::mutex> lock(this->mutex_);
+        this->condition_.wait(lock, [this]() { return !this->tasks_.empty() || this->is_stopping_; });
+        if (this->tasks_.empty()) { return; }
+        task = std::move(this->tasks_.front());
+        this->tasks_.pop_front();
+      }
+      task();
+    }
+  }
+};
+
+#endif // SEARCH_EXECUTOR_HPP_
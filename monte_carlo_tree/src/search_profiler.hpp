@@ -0,0 +1,340 @@
+#ifndef SEARCH_PROFILER_HPP_
+#define SEARCH_PROFILER_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+
+#ifdef MONTE_CARLO_PROFILE
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/* MONTE_CARLO_PROFILEを定義してビルドしたときだけ、Linuxのperf_event_openでハードウェアカウンタを数える。 */
+/* 定義しなければSearchProfilerは何も数えず、探索に埋め込んだ計測(SearchScope, SearchPhaseScope)は空になる。 */
+#ifdef MONTE_CARLO_PROFILE
+constexpr bool kIsSearchProfilingEnabled{true};
+#else
+constexpr bool kIsSearchProfilingEnabled{false};
+#endif
+
+enum class SearchCounter {
+  kCycles,
+  kInstructions,
+  kBranchMisses,
+  kCacheMisses,
+  kTaskClock, // ナノ秒。ソフトウェアのカウンタなので、ハードウェアのカウンタが使えない環境でも数えられる。
+  kNumberOfCounters
+};
+
+constexpr int kNumberOfSearchCounters{(int)SearchCounter::kNumberOfCounters};
+
+/* 探索の1回の反復の段階。 */
+enum class SearchPhase {
+  kSelection,       // 子節点の選択。
+  kExpansion,       // 節点の展開。
+  kPlayout,         // プレイアウト。
+  kBackpropagation, // 結果の反映。
+  kNumberOfPhases
+};
+
+constexpr int kNumberOfSearchPhases{(int)SearchPhase::kNumberOfPhases};
+
+using SearchCounterValues = std::array<uint64_t, kNumberOfSearchCounters>;
+
+/* SearchProfilerで数えた結果。 */
+struct SearchProfile {
+  std::array<bool, kNumberOfSearchCounters> is_available; // 数えられたカウンタ。
+  long long search_cnt;             // 数えた探索の回数。
+  long long iteration_cnt;          // 探索の反復回数。
+  long long sampled_iteration_cnt;  // そのうち段階ごとに数えた反復の回数。
+  SearchCounterValues search;       // 探索全体の合計。
+  SearchCounterValues last_search;  // 直前の探索。
+  std::array<SearchCounterValues, kNumberOfSearchPhases> phases; // 段階ごとの合計。計測自体にかかった分は引いてある。
+  std::array<long long, kNumberOfSearchPhases> phase_cnts;       // 段階ごとに数えた回数。
+
+  /* 探索1回あたりと、段階1回あたりの値を出力する。 */
+  void print(std::ostream& os) const {
+    static constexpr std::array<const char*, kNumberOfSearchPhases> kPhaseNames{"selection", "expansion", "playout", "backpropagation"};
+    os << "phase                  count        cycles  instructions     IPC  branch_misses  cache_misses      task_ns" << std::endl;
+    const auto printRow{[this, &os](const char* name, const long long cnt, const SearchCounterValues& values) {
+      os << std::left << std::setw(16) << name << std::right << std::setw(11) << cnt;
+      const int widths[kNumberOfSearchCounters]{14, 14, 15, 14, 13};
+      for (int i = 0; i < kNumberOfSearchCounters; i++) {
+        os << std::setw(widths[i]);
+        if (this->is_available[i] && cnt > 0) {
+          os << std::fixed << std::setprecision(1) << (double)values[i] / cnt;
+        } else {
+          os << "n/a";
+        }
+        if (i == (int)SearchCounter::kInstructions) {
+          const int cycles{(int)SearchCounter::kCycles};
+          const int instructions{(int)SearchCounter::kInstructions};
+          os << std::setw(8);
+          if (this->is_available[cycles] && this->is_available[instructions] && values[cycles] > 0) {
+            os << std::setprecision(2) << (double)values[instructions] / values[cycles];
+          } else {
+            os << "n/a";
+          }
+        }
+      }
+      os << std::endl;
+    }};
+    printRow("search", this->search_cnt, this->search);
+    for (int i = 0; i < kNumberOfSearchPhases; i++) {
+      printRow(kPhaseNames[i], this->phase_cnts[i], this->phases[i]);
+    }
+  }
+};
+
+/* 呼び出したスレッドのカウンタを開き、attach()した間にそのスレッドで行った探索を数える。 */
+/* カウンタは1つの組にまとめ、境目ごとにread()1回で全部を読む。開けなかったカウンタは数えず、n/aとして報告する。 */
+/* 段階の計測はsetSampleInterval()回に1回の反復だけで行い、計測自体にかかった分は作ったときに測って引く。 */
+/* 数えるのはattach()したスレッドだけなので、searchAsync()を実行するSearchExecutorなど、他のスレッドで行った探索は数えない。 */
+class SearchProfiler {
+ public:
+  SearchProfiler() {
+    if constexpr (kIsSearchProfilingEnabled) {
+      this->open();
+      this->calibrate();
+    }
+    this->reset();
+  }
+
+  SearchProfiler(const SearchProfiler&) = delete;
+  SearchProfiler& operator=(const SearchProfiler&) = delete;
+
+  ~SearchProfiler() {
+    this->detach();
+#ifdef MONTE_CARLO_PROFILE
+    for (const int fd : this->fds_) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+#endif
+  }
+
+  /* カウンタを1つでも開けたか。MONTE_CARLO_PROFILEを定義していなければfalse。 */
+  bool isAvailable() const { return this->slot_cnt_ > 0; }
+
+  bool isAvailable(const SearchCounter counter) const { return this->slots_[(int)counter] >= 0; }
+
+  /* このスレッドで行う探索を、このプロファイラで数える。 */
+  void attach() { current() = this; }
+
+  void detach() {
+    if (current() == this) {
+      current() = nullptr;
+    }
+  }
+
+  /* 段階ごとの計測を何回の反復に1回行うか。 */
+  void setSampleInterval(const int interval) { this->sample_interval_ = std::max(interval, 1); }
+
+  const SearchProfile& getProfile() const { return this->profile_; }
+
+  void reset() {
+    this->profile_ = SearchProfile{};
+    for (int i = 0; i < kNumberOfSearchCounters; i++) {
+      this->profile_.is_available[i] = this->isAvailable((SearchCounter)i);
+    }
+  }
+
+  /* このスレッドにattach()されたプロファイラ。なければnullptr。 */
+  static SearchProfiler* attached() {
+    if constexpr (kIsSearchProfilingEnabled) {
+      return current();
+    }
+    return nullptr;
+  }
+
+  /* 全カウンタの現在値をvaluesに読む。 */
+  bool read(SearchCounterValues& values) const {
+#ifdef MONTE_CARLO_PROFILE
+    if (this->slot_cnt_ <= 0) { return false; }
+    std::array<uint64_t, kNumberOfSearchCounters + 1> buffer{}; // 先頭は組のカウンタの数。
+    const ssize_t size{(ssize_t)((this->slot_cnt_ + 1) * sizeof(uint64_t))};
+    if (::read(this->fds_[this->leader_], buffer.data(), size) != size) { return false; }
+    for (int i = 0; i < kNumberOfSearchCounters; i++) {
+      values[i] = (this->slots_[i] >= 0) ? buffer[this->slots_[i] + 1] : 0;
+    }
+    return true;
+#else
+    (void)values;
+    return false;
+#endif
+  }
+
+  /* 反復を1回数え、その反復で段階ごとの計測をするか決める。 */
+  void countIteration() {
+    this->is_sampled_iteration_ = this->profile_.iteration_cnt++ % this->sample_interval_ == 0;
+    if (this->is_sampled_iteration_) {
+      this->profile_.sampled_iteration_cnt++;
+    }
+  }
+
+  bool isSampledIteration() const { return this->is_sampled_iteration_; }
+
+  void addSearch(const SearchCounterValues& begin, const SearchCounterValues& end) {
+    this->profile_.search_cnt++;
+    for (int i = 0; i < kNumberOfSearchCounters; i++) {
+      this->profile_.last_search[i] = end[i] - begin[i];
+      this->profile_.search[i] += end[i] - begin[i];
+    }
+  }
+
+  void addPhase(const SearchPhase phase, const SearchCounterValues& begin, const SearchCounterValues& end) {
+    this->profile_.phase_cnts[(int)phase]++;
+    for (int i = 0; i < kNumberOfSearchCounters; i++) {
+      const uint64_t delta{end[i] - begin[i]};
+      this->profile_.phases[(int)phase][i] += delta - std::min(delta, this->overhead_[i]);
+    }
+  }
+
+ private:
+  static constexpr int kCalibrationCount{64}; // 計測自体にかかる分を測る回数。
+
+  std::array<int, kNumberOfSearchCounters> fds_{-1, -1, -1, -1, -1};
+  std::array<int, kNumberOfSearchCounters> slots_{-1, -1, -1, -1, -1}; // 組の中での順番。開けなければ-1。
+  int slot_cnt_{};
+  int leader_{-1};
+  SearchCounterValues overhead_{}; // read()2回の間に数えられる分。
+  int sample_interval_{1};
+  bool is_sampled_iteration_{false};
+  SearchProfile profile_{};
+
+  static SearchProfiler*& current() {
+    static thread_local SearchProfiler* profiler{nullptr};
+    return profiler;
+  }
+
+#ifdef MONTE_CARLO_PROFILE
+  void open() {
+    static constexpr std::array<std::pair<uint32_t, uint64_t>, kNumberOfSearchCounters> kEvents{{
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+      {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK}
+    }};
+
+    /* 最初に開けたカウンタを組の先頭にし、組全体をまとめて動かす。 */
+    for (int i = 0; i < kNumberOfSearchCounters; i++) {
+      perf_event_attr attr{};
+      attr.size = sizeof(attr);
+      attr.type = kEvents[i].first;
+      attr.config = kEvents[i].second;
+      attr.disabled = (this->leader_ < 0) ? 1 : 0;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP;
+      const int group_fd{(this->leader_ < 0) ? -1 : this->fds_[this->leader_]};
+      const int fd{(int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0)};
+      if (fd < 0) { continue; }
+
+      this->fds_[i] = fd;
+      this->slots_[i] = this->slot_cnt_++;
+      if (this->leader_ < 0) {
+        this->leader_ = i;
+      }
+    }
+    if (this->leader_ >= 0) {
+      ioctl(this->fds_[this->leader_], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+  }
+#else
+  void open() {}
+#endif
+
+  /* 何もしない区間を数えて、計測1回あたりの分を求める。 */
+  void calibrate() {
+    SearchCounterValues sum{};
+    for (int k = 0; k < kCalibrationCount; k++) {
+      SearchCounterValues begin{};
+      SearchCounterValues end{};
+      if (!this->read(begin) || !this->read(end)) { return; }
+      for (int i = 0; i < kNumberOfSearchCounters; i++) {
+        sum[i] += end[i] - begin[i];
+      }
+    }
+    for (int i = 0; i < kNumberOfSearchCounters; i++) {
+      this->overhead_[i] = sum[i] / kCalibrationCount;
+    }
+  }
+};
+
+/* 探索1回を数える。attach()されたプロファイラがなければ何もしない。 */
+class SearchScope {
+ public:
+  SearchScope() {
+    if constexpr (kIsSearchProfilingEnabled) {
+      SearchProfiler* profiler{SearchProfiler::attached()};
+      if (profiler != nullptr && profiler->read(this->begin_)) {
+        this->profiler_ = profiler;
+      }
+    }
+  }
+
+  SearchScope(const SearchScope&) = delete;
+  SearchScope& operator=(const SearchScope&) = delete;
+
+  ~SearchScope() {
+    if constexpr (kIsSearchProfilingEnabled) {
+      SearchCounterValues end{};
+      if (this->profiler_ != nullptr && this->profiler_->read(end)) {
+        this->profiler_->addSearch(this->begin_, end);
+      }
+    }
+  }
+
+ private:
+  SearchProfiler* profiler_{nullptr};
+  SearchCounterValues begin_{};
+};
+
+/* 反復1回のうちの1つの段階を数える。段階ごとに計測する反復でなければ何もしない。 */
+class SearchPhaseScope {
+ public:
+  explicit SearchPhaseScope(const SearchPhase phase) : phase_(phase) {
+    if constexpr (kIsSearchProfilingEnabled) {
+      SearchProfiler* profiler{SearchProfiler::attached()};
+      if (profiler != nullptr && profiler->isSampledIteration() && profiler->read(this->begin_)) {
+        this->profiler_ = profiler;
+      }
+    }
+  }
+
+  SearchPhaseScope(const SearchPhaseScope&) = delete;
+  SearchPhaseScope& operator=(const SearchPhaseScope&) = delete;
+
+  ~SearchPhaseScope() {
+    if constexpr (kIsSearchProfilingEnabled) {
+      SearchCounterValues end{};
+      if (this->profiler_ != nullptr && this->profiler_->read(end)) {
+        this->profiler_->addPhase(this->phase_, this->begin_, end);
+      }
+    }
+  }
+
+  /* 反復を1回数える。根で反復を始めるたびに呼ぶ。 */
+  static void countIteration() {
+    if constexpr (kIsSearchProfilingEnabled) {
+      SearchProfiler* profiler{SearchProfiler::attached()};
+      if (profiler != nullptr) {
+        profiler->countIteration();
+      }
+    }
+  }
+
+ private:
+  SearchPhase phase_;
+  SearchProfiler* profiler_{nullptr};
+  SearchCounterValues begin_{};
+};
+
+#endif // SEARCH_PROFILER_HPP_
@@ -0,0 +1,145 @@
+#ifndef WORKER_PLACEMENT_HPP_
+#define WORKER_PLACEMENT_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "node_arena.hpp"
+
+constexpr std::size_t kCacheLineSize{64};
+
+/* 別々のスレッドが更新する値を、キャッシュラインを共有しないように並べるための包み。 */
+template <class T>
+struct alignas(kCacheLineSize) CacheAligned {
+  T value;
+};
+
+/* ワーカスレッドの置き方。 */
+struct WorkerPoolSettings {
+  bool is_pinned{false};            // ワーカをworkerCpuOrder()の順にCPUへ固定する。
+  bool is_arena_enabled{false};     // ワーカごとに、そのCPUのNUMAノードのNodeArenaを結び付ける。
+  bool is_huge_page_enabled{false}; // NodeArenaの領域に透過的ヒュージページを使う。
+};
+
+/* cpu番目のCPUのNUMAノード。分からなければ0。 */
+inline int numaNodeOfCpu(const int cpu) {
+  const std::string path{"/sys/devices/system/cpu/cpu" + std::to_string(cpu)};
+  DIR* dir{opendir(path.c_str())};
+  if (dir == nullptr) { return 0; }
+
+  int result{};
+  while (const dirent* entry = readdir(dir)) {
+    const std::string name{entry->d_name};
+    if (name.size() > 4 && name.compare(0, 4, "node") == 0 && name.find_first_not_of("0123456789", 4) == std::string::npos) {
+      result = std::stoi(name.substr(4));
+      break;
+    }
+  }
+  closedir(dir);
+  return result;
+}
+
+/* ワーカを置くCPUの順番。このプロセスが使えるCPUのうち、まず物理コアを1つずつNUMAノードを順に回って選び、 */
+/* 続けて残りのSMTの兄弟を同じ順で選ぶ。ワーカが少なくても、コアのキャッシュとNUMAノードのメモリ帯域を分け合わないようにする。 */
+inline std::vector<int> workerCpuOrder() {
+  cpu_set_t allowed{};
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) { return {}; }
+
+  const auto readTopology{[](const int cpu, const std::string& name) {
+    std::ifstream ifs("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/" + name);
+    int value{-1};
+    ifs >> value;
+    return value;
+  }};
+
+  /* NUMAノードごとに、(ソケット, コア, CPU)の順に並べる。 */
+  std::map<int, std::vector<std::tuple<int, int, int>>> cpus_by_node{};
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &allowed)) {
+      cpus_by_node[numaNodeOfCpu(cpu)].emplace_back(readTopology(cpu, "physical_package_id"), readTopology(cpu, "core_id"), cpu);
+    }
+  }
+
+  std::vector<std::vector<int>> primaries{};
+  std::vector<std::vector<int>> siblings{};
+  for (auto& [node, cpus] : cpus_by_node) {
+    std::sort(cpus.begin(), cpus.end());
+    primaries.emplace_back();
+    siblings.emplace_back();
+    for (std::size_t i = 0; i < cpus.size(); i++) {
+      const bool is_same_core{i > 0 && std::get<0>(cpus.at(i)) == std::get<0>(cpus.at(i - 1)) &&
+                              std::get<1>(cpus.at(i)) == std::get<1>(cpus.at(i - 1)) && std::get<1>(cpus.at(i)) >= 0};
+      (is_same_core ? siblings : primaries).back().push_back(std::get<2>(cpus.at(i)));
+    }
+  }
+
+  std::vector<int> result{};
+  for (const std::vector<std::vector<int>>* groups : {&primaries, &siblings}) {
+    for (std::size_t i = 0; ; i++) {
+      bool is_found{false};
+      for (const std::vector<int>& group : *groups) {
+        if (i < group.size()) {
+          result.push_back(group.at(i));
+          is_found = true;
+        }
+      }
+      if (!is_found) { break; }
+    }
+  }
+  return result;
+}
+
+/* 呼び出したスレッドをcpu番目のCPUに固定する。できなければfalseを返す。 */
+inline bool pinCurrentThread(const int cpu) {
+  cpu_set_t cpus{};
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+}
+
+/* ワーカスレッドの始めに作り、settingsに従ってworker_index番目のワーカをCPUに固定し、NodeArenaを結び付ける。 */
+/* 固定できなくても探索は続ける。スコープを抜けるとアリーナを外す。CPUの固定は、スレッドが終わるまで残る。 */
+class WorkerThreadScope {
+ public:
+  WorkerThreadScope(const WorkerPoolSettings& settings, const int worker_index) {
+    int numa_node{numaNodeOfCpu(std::max(sched_getcpu(), 0))};
+    if (settings.is_pinned) {
+      const std::vector<int> cpus{workerCpuOrder()};
+      if (!cpus.empty()) {
+        const int cpu{cpus.at(worker_index % cpus.size())};
+        this->is_pinned_ = pinCurrentThread(cpu);
+        numa_node = numaNodeOfCpu(cpu);
+      }
+    }
+    if (settings.is_arena_enabled) {
+      NodeArena::bind(numa_node, settings.is_huge_page_enabled);
+      this->is_arena_bound_ = true;
+    }
+  }
+
+  WorkerThreadScope(const WorkerThreadScope&) = delete;
+  WorkerThreadScope& operator=(const WorkerThreadScope&) = delete;
+
+  ~WorkerThreadScope() {
+    if (this->is_arena_bound_) {
+      NodeArena::unbind();
+    }
+  }
+
+  bool isPinned() const { return this->is_pinned_; }
+
+ private:
+  bool is_pinned_{false};
+  bool is_arena_bound_{false};
+};
+
+#endif // WORKER_PLACEMENT_HPP_